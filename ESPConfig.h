@@ -1,27 +1,31 @@
 #ifndef ESPConfig_h
 #define ESPConfig_h
 
-#include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
-#include <DNSServer.h>
+#include "ESPConfigPlatform.h"
+#include <functional>
 #include <memory>
-
-extern "C" {
-  #include "user_interface.h"
-}
+#include <vector>
 
 const char HTTP_HEADER[] PROGMEM                      = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
 const char HTTP_STYLE[] PROGMEM                     = "<style>.c{text-align: center;} div,input{padding:5px;font-size:1em;} input{width:95%;margin-top:3px;margin-bottom:3px;} body{text-align: center;font-family:verdana;} button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;margin-top:3px;} .q{float: right;width: 64px;text-align: right;} .l{background: url(\"data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5ErkJggg==\") no-repeat left center;background-size: 1em;}</style>";
 const char HTTP_SCRIPT[] PROGMEM                    = "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();}</script>";
 const char HTTP_HEADER_END[] PROGMEM                  = "</head><body><div style='text-align:left;display:inline-block;min-width:260px;'>";
 const char HTTP_ITEM[] PROGMEM                      = "<div><a href='#p' onclick='c(this)'>{v}</a>&nbsp;<span class='q {i}'>{r}%</span></div>";
-const char HTTP_FORM_START[] PROGMEM                = "<form method='get' action='wifisave'><input id='s' name='s' length=32 placeholder='SSID' required><br/><input id='p' name='p' length=64 type='password' placeholder='password' required><hr/>";
+const char HTTP_FORM_START[] PROGMEM                = "<form method='get' action='wifisave'><input id='s' name='s' length=32 placeholder='SSID' value='{v}' required><br/><input id='p' name='p' length=64 type='password' placeholder='password' required><hr/>";
+const char HTTP_FORM_DRAFT[] PROGMEM                = "<script>document.forms[0].onchange=function(e){var t=e.target;if(t.name!='p')fetch('draft?'+t.name+'='+encodeURIComponent(t.value));};</script>";
 const char HTTP_FORM_INPUT[] PROGMEM                = "<input id='{i}' name='{n}' placeholder='{p}' maxlength={l} value='{v}' {c}><br/>";
-const char HTTP_FORM_INPUT_LIST[] PROGMEM           = "<input id='{i}' name='{n}' placeholder='{p}' list='d' {c}><datalist id='d'{o}></datalist><br/>";
+const char HTTP_FORM_INPUT_LIST[] PROGMEM           = "<input id='{i}' name='{n}' placeholder='{p}' list='d' {c}><datalist id='d'>";
 const char HTTP_FORM_INPUT_LIST_OPTION[] PROGMEM    = "<option>{o}</option>";
+const char HTTP_FORM_INPUT_LIST_END[] PROGMEM       = "</datalist><br/>";
 const char HTTP_FORM_END[] PROGMEM                  = "<hr/><button type='submit'>Save</button></form>";
 const char HTTP_SCAN_LINK[] PROGMEM                 = "<br/><div class=\"c\"><a href=\"/scan\">Scan for networks</a></div>";
 const char HTTP_SAVED[] PROGMEM                     = "<div>Credentials Saved<br/>Trying to connect ESP to network.<br/>If it fails reconnect to AP to try again</div>";
+const char HTTP_TITLE[] PROGMEM                     = "<h2>Module config</h2>";
+const char HTTP_NO_NETWORKS[] PROGMEM               = "No networks found. Refresh to scan again.";
+const char HTTP_UPDATE_LINK[] PROGMEM               = "<div class=\"c\"><a href=\"/update\">Firmware update</a></div>";
+const char HTTP_UPDATE_FORM[] PROGMEM               = "<form method='post' enctype='multipart/form-data' onsubmit=\"this.action='update?md5='+this.m.value+'&size='+this.f.files[0].size\"><input id='f' name='f' type='file' accept='.bin' required><br/><input id='m' name='m' maxlength=32 placeholder='MD5 (optional)'><hr/><button type='submit'>Update</button></form>";
+const char HTTP_UPDATE_DONE[] PROGMEM               = "<div>Update done. Rebooting...</div>";
+const char HTTP_UPDATE_FAILED[] PROGMEM             = "<div>Update failed (error {e}). The running firmware is kept.</div>";
 const char HTTP_END[] PROGMEM                       = "</div></body></html>";
 
 #ifndef INVALID_PIN_NO
@@ -32,6 +36,27 @@ const char HTTP_END[] PROGMEM                       = "</div></body></html>";
 #define ESP_CONFIG_MAX_PARAMS 10
 #endif
 
+/* Only used with ESP_CONFIG_STATIC_MEMORY */
+#ifndef ESP_CONFIG_MAX_SCAN_ENTRIES
+#define ESP_CONFIG_MAX_SCAN_ENTRIES 16
+#endif
+
+#ifndef ESP_CONFIG_RENDER_BUFFER
+#define ESP_CONFIG_RENDER_BUFFER 6144
+#endif
+
+/* Params per fragment when rendering or saving them in parallel (host builds only) */
+#ifndef ESP_CONFIG_PARAMS_GRAIN
+#define ESP_CONFIG_PARAMS_GRAIN 16
+#endif
+
+/* Bytes kept for the portal form draft of the default memory policies, see setSessionResume (256 at most on ESP8266) */
+#ifndef ESP_CONFIG_DRAFT_SIZE
+#define ESP_CONFIG_DRAFT_SIZE 256
+#endif
+
+#include "ESPConfigMemory.h"
+
 enum InputType {Combo, Text};
 
 class ESPConfigParam {
@@ -39,6 +64,8 @@ class ESPConfigParam {
     public:
         ESPConfigParam();
         ESPConfigParam (InputType type, const char* name, const char* label, const char* defVal, uint8_t length, const char* html);
+        // Keeps the value in the buffer provided (length + 1 chars) instead of allocating one
+        ESPConfigParam (InputType type, const char* name, const char* label, const char* defVal, uint8_t length, const char* html, char* buffer);
         ~ESPConfigParam();
 
         InputType           getType();
@@ -47,7 +74,7 @@ class ESPConfigParam {
         const char*         getValue();
         int                 getValueLength();
         const char*         getCustomHTML();
-        std::vector<char*>  getOptions();
+        const std::vector<char*>& getOptions();
 
         void                updateValue(const char *v);
 
@@ -55,16 +82,36 @@ class ESPConfigParam {
         const char*         _name;       // identificador
         const char*         _label;      // legible por usuario
         char*               _value;      // valor default
+        bool                _ownsValue;  // _value fue alocado por el param
         uint8_t             _length;     // longitud limite
         const char*         _customHTML; // html custom
         InputType           _type;       // tipo de control en formularion
         std::vector<char*>  _options;    // optciones para el combo
 };
 
-class ESPConfig {
+/* Param with its value buffer reserved at compile time */
+template <uint8_t Length>
+class ESPConfigStaticParam : public ESPConfigParam {
     public:
-        ESPConfig();
-        ~ESPConfig();
+        ESPConfigStaticParam (InputType type, const char* name, const char* label, const char* defVal, const char* html)
+            : ESPConfigParam(type, name, label, defVal, Length, html, _buffer) {}
+
+    private:
+        char                _buffer[Length + 1];
+};
+
+/*
+ * Traits must provide the HttpServer and DnsServer types plus the static functions wifi(), millis(),
+ * delay(), yield(), digitalWrite(), chipId(), setHostname(), stationDisconnect() and isOpenNetwork().
+ * Firmware updates also need the Updater type and updater(), updateSpace(), abortUpdate() and restart(),
+ * session resume loadDraft() and storeDraft().
+ * See ESPConfigPlatform.h.
+ * Memory is one of the policies in ESPConfigMemory.h.
+ */
+template <class Traits, class Memory = ESPConfigHeapMemory<>>
+class BasicESPConfig {
+    public:
+        BasicESPConfig();
 
         /* launch methods */
         bool            connectWifiNetwork(bool existConfig);
@@ -79,15 +126,20 @@ class ESPConfig {
         bool            addParameter(ESPConfigParam *p);
         void            setFeedbackPin(uint8_t pin);
         void            setAPStaticIP(IPAddress ip, IPAddress gw, IPAddress sn);
+        // Serves the /update page to flash a new firmware from the portal to the clients logged in with these
+        // credentials (disabled by default). Only with a portal password, NULL disables it again
+        void            setFirmwareUpdate(const char* user, const char* pass);
+        // Autosaves the portal form as it is filled and, after a reset, reopens the portal with it (disabled by default)
+        void            setSessionResume(bool enabled);
         
         // Returns the param under the specified index
-        ESPConfigParam *getParameter(uint8_t index);
+        ESPConfigParam *getParameter(uint16_t index);
 
         // Returns the numer of params existing
-        uint8_t         getParamsCount();
+        uint16_t        getParamsCount();
 
         //called when AP mode and config portal is started
-        void    setAPCallback (std::function<void(ESPConfig*)> callback);
+        void    setAPCallback (std::function<void(BasicESPConfig*)> callback);
         
         //called when connecting station to AP
         void    setStationNameCallback (std::function<const char*(void)> callback);
@@ -95,6 +147,9 @@ class ESPConfig {
         //called when settings have been changed and connection was successful
         void    setSaveConfigCallback (std::function<void(void)> callback);
         
+        //called for every firmware chunk written, size is 0 when the client did not tell it
+        void    setUpdateProgressCallback (std::function<void(size_t progress, size_t size)> callback);
+        
         //defaults to not showing anything under 8% signal quality if called
         void    setMinimumSignalQuality (int quality = 8);
 
@@ -106,53 +161,82 @@ class ESPConfig {
 
     private:
 
-        std::unique_ptr<DNSServer>        _dnsServer;
-        std::unique_ptr<ESP8266WebServer> _server;
+        typedef typename Traits::HttpServer HttpServer;
+        typedef typename Traits::DnsServer  DnsServer;
+
+        typename Memory::template Slot<DnsServer>   _dnsServer;
+        typename Memory::template Slot<HttpServer>  _server;
+        typename Memory::Params                     _configParams;
+        typename Memory::Page                       _page;
+        
+        char            _chipIdName[11];
         
         const char*     _apName             = "ESP-Module";
         const char*     _apPass             = NULL;
         int             _minimumQuality     = -1;
-        uint8_t         _paramsCount        = 0;
-        uint8_t         _max_params;
         bool            _connect;
+        bool            _firmwareUpdate     = false;
+        const char*     _updateUser         = NULL;
+        const char*     _updatePass         = NULL;
+        bool            _updateOk           = false;
+        uint8_t         _updateError        = UPDATE_ERROR_OK;  // failures the updater does not record itself
+        size_t          _updateSize         = 0;
+        bool            _restart            = false;
+        bool            _sessionResume      = false;
+
+        typename Memory::template Slot<typename Memory::Draft> _draft;  // created by loadDraft()
         uint8_t         _feedbackPin        = INVALID_PIN_NO;
 
         const uint8_t   DNS_PORT            = 53;
 
-        uint8_t connectWifi(String ssid, String pass);
+        uint8_t connectWifi(const char* ssid, const char* pass);
         uint8_t connectWiFi();
         uint8_t waitForConnectResult();
         void    setupConfigPortal();
 
-        unsigned long       _wifiConnectTimeout;
-        unsigned long       _configPortalTimeout;
-        unsigned long       _configPortalStart;
+        unsigned long       _wifiConnectTimeout     = 0;
+        unsigned long       _configPortalTimeout    = 0;
+        unsigned long       _configPortalStart      = 0;
         
         // Signal feedback
         bool                _sigfbkIsOn           = false;
         unsigned long       _sigfbkStepControl    = 0;
-        ESPConfigParam**    _configParams;
         
         IPAddress           _ap_static_ip;
         IPAddress           _ap_static_gw;
         IPAddress           _ap_static_sn;
 
         /* Callbacks */
-        std::function<void(ESPConfig*)>     _apcallback;
+        std::function<void(BasicESPConfig*)>     _apcallback;
         std::function<const char*(void)>    _stationNameCallback;
         std::function<void(void)>           _savecallback;
+        std::function<void(size_t, size_t)> _updateProgressCallback;
         
         void        handleRoot();
         void        handleWifi(bool scan);
         void        handleWifiSave();
+        void        handleDraft();
+        void        loadDraft();
+        void        storeDraft();
+        bool        resumeSession();
+        void        handleUpdate();
+        void        handleUpdateUpload();
+        void        handleUpdateDone();
+        void        appendHead(const char* title);
+        void        appendParams();
+        void        renderParams(typename Memory::Page& page, uint16_t from, uint16_t to);
+        void        saveParams();
+        void        updateParams(uint16_t from, uint16_t to);
         void        handleInfo();
         void        handleReset();
         void        handleNotFound();
         void        handle204();
+        int         argIndex(const char* name);
+        void        sendPage(int code, const char* contentType);
         bool        captivePortal();
         bool        configPortalHasTimeout();
-        bool        isIp(String str);
-        String      toStringIp(IPAddress ip);
+        bool        isIp(const String& str);
+        void        toStringIp(IPAddress ip, char* buffer, size_t size);
         int         getRSSIasQuality(int RSSI);
 
         #ifdef LOGGING
@@ -160,4 +244,18 @@ class ESPConfig {
         template <class T, class U> void debug(T key, U value);
         #endif
 };
+
+#ifdef ESP_CONFIG_STATIC_MEMORY
+typedef ESPConfigStaticMemory<ESP_CONFIG_MAX_PARAMS, ESP_CONFIG_MAX_SCAN_ENTRIES, ESP_CONFIG_RENDER_BUFFER, ESP_CONFIG_DRAFT_SIZE> ESPConfigDefaultMemory;
+#else
+typedef ESPConfigHeapMemory<ESP_CONFIG_DRAFT_SIZE> ESPConfigDefaultMemory;
+#endif
+
+typedef BasicESPConfig<ESPConfigDefaultTraits, ESPConfigDefaultMemory> ESPConfig;
+
+#include "ESPConfigImpl.h"
+
+// instantiated once in ESPConfig.cpp
+extern template class BasicESPConfig<ESPConfigDefaultTraits, ESPConfigDefaultMemory>;
+
 #endif
\ No newline at end of file
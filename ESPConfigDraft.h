@@ -0,0 +1,103 @@
+#ifndef ESPConfigDraft_h
+#define ESPConfigDraft_h
+
+/*
+ * Portal form draft. Keeps the values typed into the portal form (the ssid and the params, never
+ * the password) as "name\0value\0" pairs in a fixed buffer, plus a flag telling the portal was
+ * running. The whole object is what the traits copy to memory surviving a reset, so it has no
+ * pointers and is checked with a magic and a checksum when read back.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+template <size_t Size>
+class ESPConfigDraft {
+    public:
+        static_assert(Size % 4 == 0 && Size > 8, "The draft size must be a multiple of 4 bigger than 8");
+
+        ESPConfigDraft() { clear(); }
+
+        /* Drops everything, used as well when what was read back is not a draft */
+        void clear() {
+            _magic = MAGIC;
+            _length = 0;
+            _resume = 0;
+            _check = checksum();
+        }
+
+        bool valid() const {
+            return _magic == MAGIC && _length <= sizeof(_data) && _check == checksum();
+        }
+
+        bool resume() const { return _resume != 0; }
+
+        void setResume(bool resume) {
+            _resume = resume ? 1 : 0;
+            _check = checksum();
+        }
+
+        /* Value kept for name, NULL if there is none */
+        const char* get(const char* name) const {
+            for (size_t i = 0; i < _length; ) {
+                const char* n = _data + i;
+                const char* v = n + strlen(n) + 1;
+                if (strcmp(n, name) == 0) {
+                    return v;
+                }
+                i = v + strlen(v) + 1 - _data;
+            }
+            return NULL;
+        }
+
+        /* Replaces the value kept for name, false (keeping the old one) if it does not fit */
+        bool set(const char* name, const char* value) {
+            size_t n = strlen(name) + 1;
+            size_t v = strlen(value) + 1;
+            const char* old = get(name);
+            size_t kept = old != NULL ? _length - n - strlen(old) - 1 : _length;
+            if (kept + n + v > sizeof(_data)) {
+                return false;
+            }
+            remove(name);
+            memcpy(_data + _length, name, n);
+            memcpy(_data + _length + n, value, v);
+            _length += n + v;
+            _check = checksum();
+            return true;
+        }
+
+    private:
+        static const uint32_t MAGIC = 0x45434466;
+
+        uint32_t    _magic;
+        uint16_t    _length;
+        uint8_t     _resume;
+        uint8_t     _check;
+        char        _data[Size - 8];
+
+        void remove(const char* name) {
+            for (size_t i = 0; i < _length; ) {
+                const char* n = _data + i;
+                const char* v = n + strlen(n) + 1;
+                size_t end = v + strlen(v) + 1 - _data;
+                if (strcmp(n, name) == 0) {
+                    memmove(_data + i, _data + end, _length - end);
+                    _length -= end - i;
+                    return;
+                }
+                i = end;
+            }
+        }
+
+        uint8_t checksum() const {
+            uint8_t c = (uint8_t) (_length ^ (_length >> 8) ^ _resume ^ 0x5A);
+            for (size_t i = 0; i < _length && i < sizeof(_data); ++i) {
+                c = (uint8_t) ((c << 1) | (c >> 7)) ^ (uint8_t) _data[i];
+            }
+            return c;
+        }
+};
+
+#endif
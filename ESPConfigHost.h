@@ -0,0 +1,1364 @@
+#ifndef ESPConfigHost_h
+#define ESPConfigHost_h
+
+/*
+ * Host (desktop) implementation of the platform pieces ESPConfig depends on.
+ * Everything is simulated: the clock only moves when the library calls delay/yield,
+ * the radio resolves connections against a configurable list of networks and the
+ * web server serves requests from a script instead of a socket.
+ *
+ * Every simulated device lives in a HostSim. The active one is thread local, so each
+ * thread can drive its own device independently.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef F
+#define F(s) (s)
+#endif
+#ifndef FPSTR
+#define FPSTR(p) (p)
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*(const uint8_t*) (addr))
+#endif
+typedef const char* PGM_P;
+
+#ifndef HIGH
+#define HIGH 0x1
+#endif
+#ifndef LOW
+#define LOW  0x0
+#endif
+
+/*
+ * Allocation accounting. Host platform calls run inside a HostPlatformScope, so a program replacing
+ * operator new can tell allocations made by the library (no scope active) from the simulated
+ * platform ones. Page handlers are run in a HostLibraryScope since they are library code again.
+ */
+class HostPlatformScope {
+    public:
+        HostPlatformScope() { depth()++; }
+        ~HostPlatformScope() { depth()--; }
+
+        static bool active() { return depth() > 0; }
+
+        static int& depth() {
+            static thread_local int d = 0;
+            return d;
+        }
+};
+
+class HostLibraryScope {
+    public:
+        HostLibraryScope() : _saved(HostPlatformScope::depth()) { HostPlatformScope::depth() = 0; }
+        ~HostLibraryScope() { HostPlatformScope::depth() = _saved; }
+
+    private:
+        int _saved;
+};
+
+/* Minimal Arduino String look alike, backed by std::string */
+class String {
+    public:
+        String() {}
+        String(const char* s) : _s(s != NULL ? s : "") {}
+        String(const std::string& s) : _s(s) {}
+        explicit String(char c) : _s(1, c) {}
+        template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        explicit String(T v) : _s(std::to_string(v)) {}
+
+        unsigned int        length() const { return _s.length(); }
+        const char*         c_str() const { return _s.c_str(); }
+        const std::string&  str() const { return _s; }
+        char                charAt(unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+        bool                concat(const String& s) { _s += s._s; return true; }
+        void                reserve(unsigned int size) { _s.reserve(size); }
+
+        void replace(const String& find, const String& replace) {
+            if (find._s.empty()) {
+                return;
+            }
+            size_t pos = 0;
+            while ((pos = _s.find(find._s, pos)) != std::string::npos) {
+                _s.replace(pos, find._s.length(), replace._s);
+                pos += replace._s.length();
+            }
+        }
+
+        void toCharArray(char* buf, unsigned int bufsize) const {
+            if (buf == NULL || bufsize == 0) {
+                return;
+            }
+            size_t n = _s.length() < bufsize - 1 ? _s.length() : bufsize - 1;
+            memcpy(buf, _s.data(), n);
+            buf[n] = '\0';
+        }
+
+        String& operator+=(const String& s) { _s += s._s; return *this; }
+        String& operator+=(const char* s) { if (s != NULL) _s += s; return *this; }
+        String& operator+=(char c) { _s += c; return *this; }
+        template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        String& operator+=(T v) { _s += std::to_string(v); return *this; }
+
+        bool operator==(const String& s) const { return _s == s._s; }
+        bool operator!=(const String& s) const { return _s != s._s; }
+        bool operator==(const char* s) const { return _s == s; }
+        bool operator!=(const char* s) const { return _s != s; }
+        // true even when empty, like the core String whose buffer always exists
+        explicit operator bool() const { return true; }
+
+        friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+
+    private:
+        std::string _s;
+};
+
+class IPAddress {
+    public:
+        IPAddress() : _address(0) {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | (b << 8) | (c << 16) | ((uint32_t) d << 24)) {}
+        IPAddress(uint32_t address) : _address(address) {}
+
+        operator uint32_t() const { return _address; }
+
+        String toString() const {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address & 0xFF, (_address >> 8) & 0xFF, (_address >> 16) & 0xFF, (_address >> 24) & 0xFF);
+            return String(buf);
+        }
+
+    private:
+        uint32_t _address;
+};
+
+/* Same values used by the ESP8266 core */
+typedef enum {
+    WL_NO_SHIELD        = 255,
+    WL_IDLE_STATUS      = 0,
+    WL_NO_SSID_AVAIL    = 1,
+    WL_SCAN_COMPLETED   = 2,
+    WL_CONNECTED        = 3,
+    WL_CONNECT_FAILED   = 4,
+    WL_CONNECTION_LOST  = 5,
+    WL_DISCONNECTED     = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3
+} WiFiMode_t;
+
+enum { ENC_TYPE_TKIP = 2, ENC_TYPE_CCMP = 4, ENC_TYPE_WEP = 5, ENC_TYPE_NONE = 7, ENC_TYPE_AUTO = 8 };
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+enum class DNSReplyCode { NoError = 0, FormError = 1, ServerFailure = 2, NonExistentDomain = 3, NotImplemented = 4, Refused = 5 };
+
+/* Same values used by the ESP8266 core */
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+#ifndef HTTP_UPLOAD_BUFLEN
+#define HTTP_UPLOAD_BUFLEN 2048
+#endif
+
+struct HTTPUpload {
+    HTTPUploadStatus    status;
+    String              filename;
+    String              name;
+    String              type;
+    size_t              totalSize;
+    size_t              currentSize;
+    uint8_t             buf[HTTP_UPLOAD_BUFLEN];
+};
+
+enum {
+    UPDATE_ERROR_OK = 0, UPDATE_ERROR_WRITE = 1, UPDATE_ERROR_ERASE = 2, UPDATE_ERROR_READ = 3, UPDATE_ERROR_SPACE = 4,
+    UPDATE_ERROR_SIZE = 5, UPDATE_ERROR_STREAM = 6, UPDATE_ERROR_MD5 = 7
+};
+
+/* RFC 1321 MD5, what the ESP updaters use to verify an image */
+class HostMD5 {
+    public:
+        HostMD5() { begin(); }
+
+        void begin() {
+            _state[0] = 0x67452301; _state[1] = 0xefcdab89; _state[2] = 0x98badcfe; _state[3] = 0x10325476;
+            _length = 0;
+        }
+
+        void add(const uint8_t* data, size_t len) {
+            size_t used = _length % 64;
+            _length += len;
+            while (len > 0) {
+                size_t n = 64 - used < len ? 64 - used : len;
+                memcpy(_block + used, data, n);
+                used += n;
+                data += n;
+                len -= n;
+                if (used == 64) {
+                    transform(_block);
+                    used = 0;
+                }
+            }
+        }
+
+        /* Lower case hex digest, finishes the calculation */
+        std::string hex() {
+            uint64_t bits = _length * 8;
+            uint8_t pad = 0x80;
+            add(&pad, 1);
+            pad = 0;
+            while (_length % 64 != 56) {
+                add(&pad, 1);
+            }
+            uint8_t size[8];
+            for (int i = 0; i < 8; ++i) {
+                size[i] = (uint8_t) (bits >> (8 * i));
+            }
+            add(size, 8);
+            char out[33];
+            for (int i = 0; i < 16; ++i) {
+                snprintf(out + 2 * i, 3, "%02x", (unsigned int) ((_state[i / 4] >> (8 * (i % 4))) & 0xFF));
+            }
+            return std::string(out);
+        }
+
+    private:
+        uint32_t    _state[4];
+        uint64_t    _length;
+        uint8_t     _block[64];
+
+        static uint32_t rotate(uint32_t x, int c) { return (x << c) | (x >> (32 - c)); }
+
+        void transform(const uint8_t* block) {
+            static const uint32_t K[64] = {
+                0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+                0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+                0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+                0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+                0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+                0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+                0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+            };
+            static const int R[64] = {
+                7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+                4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+            };
+            uint32_t w[16];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | ((uint32_t) block[i * 4 + 3] << 24);
+            }
+            uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+            for (int i = 0; i < 64; ++i) {
+                uint32_t f;
+                int g;
+                if (i < 16) {
+                    f = (b & c) | (~b & d);
+                    g = i;
+                } else if (i < 32) {
+                    f = (d & b) | (~d & c);
+                    g = (5 * i + 1) % 16;
+                } else if (i < 48) {
+                    f = b ^ c ^ d;
+                    g = (3 * i + 5) % 16;
+                } else {
+                    f = c ^ (b | ~d);
+                    g = (7 * i) % 16;
+                }
+                uint32_t t = d;
+                d = c;
+                c = b;
+                b = b + rotate(a + f + K[i] + w[g], R[i]);
+                a = t;
+            }
+            _state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+        }
+};
+
+/*
+ * Update object replacement writing to the HostSim fake flash. Like the ESP updaters it only keeps
+ * one sector in RAM, and the image written becomes the running firmware only if it verifies and
+ * the device restarts; otherwise the current firmware stays (rollback).
+ */
+class HostUpdater {
+    public:
+        bool        begin(size_t size);
+        bool        setMD5(const char* expected);
+        size_t      write(uint8_t* data, size_t len);
+        bool        end(bool evenIfRemaining = false);
+        void        abort();
+
+        bool        isRunning() { return _running; }
+        bool        hasError() { return _error != UPDATE_ERROR_OK; }
+        uint8_t     getError() { return _error; }
+        size_t      size() { return _size; }
+        size_t      progress() { return _progress; }
+
+    private:
+        bool                    _running    = false;
+        uint8_t                 _error      = UPDATE_ERROR_OK;
+        size_t                  _size       = 0;
+        size_t                  _progress   = 0;
+        std::string             _expectedMd5;
+        HostMD5                 _md5;
+        std::vector<uint8_t>    _sector;
+        std::string             _image;
+
+        void flushSector();
+};
+
+struct HostNetwork {
+    String      ssid;
+    String      password;
+    int32_t     rssi;
+    uint8_t     encryption;
+};
+
+struct HostRequest {
+    unsigned long                           at;         // simulated millis when the client sends it
+    String                                  uri;
+    HTTPMethod                              method;
+    String                                  host;
+    std::vector<std::pair<String, String>>  args;
+    String                                  user;       // basic auth credentials sent, empty for none
+    String                                  pass;
+    bool                                    upload      = false;
+    std::string                             body;       // file uploaded
+    unsigned long                           chunkMillis = 0;    // millis the client takes to send each chunk
+    size_t                                  interruptAt = std::string::npos;    // bytes sent before the client drops
+};
+
+struct HostResponse {
+    unsigned long   requestAt;
+    unsigned long   at;
+    String          uri;
+    int             code;
+    String          contentType;
+    String          content;
+    double          handlerMillis   = 0;    // host wall time the page handler took, for benchmarks
+};
+
+/*
+ * Thrown from the simulated clock to emulate a reset (watchdog, brownout) in the middle of whatever
+ * the library was doing. The program driving the device catches it, calls HostSim::reboot() and
+ * runs the setup again.
+ */
+struct HostReset {};
+
+/* State of one simulated device */
+class HostSim {
+    public:
+        /* clock */
+        unsigned long   now                 = 0;
+        unsigned long   tick                = 1;        // millis consumed by every yield()
+
+        /* chip */
+        uint32_t        chipId              = 0x00C0FFEE;
+        uint8_t         pins[32]            = {0};
+
+        /* radio environment */
+        std::vector<HostNetwork>    networks;
+        unsigned long   connectDelay        = 1500;     // millis the station takes to associate
+        unsigned long   scanDuration        = 2000;     // millis a scan blocks
+        uint8_t         stations            = 0;        // clients associated to the soft AP
+
+        /* radio state */
+        WiFiMode_t      mode                = WIFI_OFF;
+        bool            persistent          = true;
+        String          savedSsid;
+        String          savedPass;
+        String          staSsid;
+        String          staPass;
+        String          hostname;
+        bool            connecting          = false;
+        unsigned long   connectStart        = 0;
+        wl_status_t     status              = WL_DISCONNECTED;
+        bool            apUp                = false;
+        unsigned long   apStartAt           = 0;
+        unsigned long   apStartDelay        = 100;      // millis until the soft AP gets its IP
+        unsigned long   configWriteMillis   = 30;       // millis to write the radio config to flash when persistent
+        String          apName;
+        String          apPass;
+        IPAddress       apIP                = IPAddress(192, 168, 4, 1);
+        unsigned int    scans               = 0;
+        unsigned int    connectAttempts     = 0;
+        std::vector<wl_status_t>    connectResults;     // outcome of every station connection attempt
+
+        /* http */
+        String          authUser;                       // basic auth credentials of the requests queued from now on
+        String          authPass;
+        std::deque<HostRequest>     requests;
+        std::vector<HostResponse>   responses;
+        bool            serverUp            = false;
+        unsigned long   serverUpAt          = 0;
+        bool            dnsUp               = false;
+
+        /* flash */
+        size_t          flashSize           = 1 << 20;  // room for a new image
+        size_t          flashSector         = 4096;
+        unsigned long   flashSectorMillis   = 25;       // millis to erase and write a sector
+        std::string     firmware            = "factory";    // image running
+        std::string     staged;                         // verified image to boot on next restart
+        unsigned int    flashWrites         = 0;
+        unsigned int    restarts            = 0;
+        HostUpdater     updater;
+
+        /* memory kept across resets but not power loss (RTC memory) */
+        std::vector<uint8_t>        rtcMemory;
+        unsigned int    resets              = 0;
+
+        /* scripted environment changes (phones joining, APs flapping...) keyed by simulated millis */
+        std::multimap<unsigned long, std::function<void(HostSim&)>> events;
+
+        static HostSim& current() {
+            return *slot();
+        }
+
+        /* Makes this the device driven by the calling thread */
+        void activate() {
+            slot() = this;
+        }
+
+        void advance(unsigned long ms) {
+            HostPlatformScope platform;
+            now += ms;
+            while (!events.empty() && events.begin()->first <= now) {
+                std::function<void(HostSim&)> event = events.begin()->second;
+                events.erase(events.begin());
+                event(*this);
+            }
+        }
+
+        /* Runs 'event' once the clock reaches 'when' */
+        void at(unsigned long when, std::function<void(HostSim&)> event) {
+            events.insert(std::make_pair(when, event));
+        }
+
+        void addNetwork(const char* ssid, const char* password, int32_t rssi) {
+            HostNetwork n;
+            n.ssid = ssid;
+            n.password = password != NULL ? password : "";
+            n.rssi = rssi;
+            n.encryption = password != NULL && strlen(password) > 0 ? ENC_TYPE_CCMP : ENC_TYPE_NONE;
+            networks.push_back(n);
+        }
+
+        /*
+         * Resets the chip: the radio, the servers and the connections of the clients are lost, flash
+         * and RTC memory stay (unless it is a power loss) and a verified update boots.
+         */
+        void reboot(bool powerLoss = false) {
+            HostPlatformScope platform;
+            resets++;
+            mode = WIFI_OFF;
+            persistent = true;
+            staSsid = String();
+            staPass = String();
+            connecting = false;
+            status = WL_DISCONNECTED;
+            apUp = false;
+            stations = 0;
+            requests.clear();
+            serverUp = false;
+            dnsUp = false;
+            updater = HostUpdater();
+            if (!staged.empty()) {
+                firmware = staged;
+                staged.clear();
+            }
+            if (powerLoss) {
+                rtcMemory.clear();
+            }
+        }
+
+        /* Resets the chip at 'when' wherever the code running is, see HostReset */
+        void resetAt(unsigned long when) {
+            at(when, [](HostSim&) { throw HostReset(); });
+        }
+
+        /* Queues a request sent by a portal client at simulated time 'at' */
+        void request(unsigned long at, const char* uri, std::vector<std::pair<String, String>> args = {}, const char* host = "192.168.4.1") {
+            HostRequest r;
+            r.at = at;
+            r.uri = uri;
+            r.method = HTTP_GET;
+            r.host = host;
+            r.args = args;
+            r.user = authUser;
+            r.pass = authPass;
+            requests.push_back(r);
+        }
+
+        void removeNetwork(const String& ssid) {
+            for (size_t i = 0; i < networks.size(); ++i) {
+                if (networks[i].ssid == ssid) {
+                    networks.erase(networks.begin() + i);
+                    return;
+                }
+            }
+        }
+
+        /* Queues a firmware upload (POST multipart) sent in HTTP_UPLOAD_BUFLEN chunks, chunkMillis apart */
+        void upload(unsigned long at, const char* uri, const std::string& image, std::vector<std::pair<String, String>> args = {}, unsigned long chunkMillis = 10, size_t interruptAt = std::string::npos) {
+            HostRequest r;
+            r.at = at;
+            r.uri = uri;
+            r.method = HTTP_POST;
+            r.host = "192.168.4.1";
+            r.args = args;
+            r.user = authUser;
+            r.pass = authPass;
+            r.upload = true;
+            r.body = image;
+            r.chunkMillis = chunkMillis;
+            r.interruptAt = interruptAt;
+            requests.push_back(r);
+        }
+
+        const HostNetwork* findNetwork(const String& ssid) const {
+            for (size_t i = 0; i < networks.size(); ++i) {
+                if (networks[i].ssid == ssid) {
+                    return &networks[i];
+                }
+            }
+            return NULL;
+        }
+
+    private:
+        static HostSim*& slot() {
+            static thread_local HostSim fallback;
+            static thread_local HostSim* sim = &fallback;
+            return sim;
+        }
+};
+
+inline bool HostUpdater::begin(size_t size) {
+    HostPlatformScope platform;
+    HostSim& sim = HostSim::current();
+    _running = false;
+    _progress = 0;
+    _expectedMd5.clear();
+    _md5.begin();
+    _sector.clear();
+    _image.clear();
+    if (size == 0 || size > sim.flashSize) {
+        _error = UPDATE_ERROR_SPACE;
+        return false;
+    }
+    _error = UPDATE_ERROR_OK;
+    _size = size;
+    _running = true;
+    _sector.reserve(sim.flashSector);
+    return true;
+}
+
+inline bool HostUpdater::setMD5(const char* expected) {
+    HostPlatformScope platform;
+    if (expected == NULL || strlen(expected) != 32) {
+        return false;
+    }
+    _expectedMd5 = expected;
+    for (size_t i = 0; i < _expectedMd5.size(); ++i) {
+        _expectedMd5[i] = (char) tolower(_expectedMd5[i]);
+    }
+    return true;
+}
+
+inline size_t HostUpdater::write(uint8_t* data, size_t len) {
+    HostPlatformScope platform;
+    if (!_running || hasError()) {
+        return 0;
+    }
+    if (_progress + len > _size) {
+        _error = UPDATE_ERROR_SPACE;
+        _running = false;
+        return 0;
+    }
+    HostSim& sim = HostSim::current();
+    _md5.add(data, len);
+    for (size_t written = 0; written < len; ) {
+        size_t n = sim.flashSector - _sector.size();
+        n = n < len - written ? n : len - written;
+        _sector.insert(_sector.end(), data + written, data + written + n);
+        written += n;
+        if (_sector.size() == sim.flashSector) {
+            flushSector();
+        }
+    }
+    _progress += len;
+    return len;
+}
+
+inline bool HostUpdater::end(bool evenIfRemaining) {
+    HostPlatformScope platform;
+    if (!_running) {
+        return false;
+    }
+    _running = false;
+    if (hasError()) {
+        return false;
+    }
+    if (!evenIfRemaining && _progress != _size) {
+        _error = UPDATE_ERROR_READ;
+        return false;
+    }
+    flushSector();
+    if (!_expectedMd5.empty() && _md5.hex() != _expectedMd5) {
+        _error = UPDATE_ERROR_MD5;
+        return false;
+    }
+    HostSim::current().staged = _image;
+    return true;
+}
+
+inline void HostUpdater::abort() {
+    _running = false;
+    _error = UPDATE_ERROR_STREAM;
+}
+
+inline void HostUpdater::flushSector() {
+    if (_sector.empty()) {
+        return;
+    }
+    HostSim& sim = HostSim::current();
+    _image.append(_sector.begin(), _sector.end());
+    _sector.clear();
+    sim.flashWrites++;
+    sim.advance(sim.flashSectorMillis);
+}
+
+/* WiFi object replacement. Stateless, every call works on the active HostSim. */
+class HostRadio {
+    public:
+        bool mode(WiFiMode_t m) {
+            HostSim& sim = HostSim::current();
+            if (sim.persistent && sim.mode != m) {
+                sim.advance(sim.configWriteMillis);
+            }
+            sim.mode = m;
+            if (m == WIFI_OFF || m == WIFI_STA) {
+                sim.apUp = false;
+                sim.stations = 0;
+            }
+            if (m == WIFI_OFF || m == WIFI_AP) {
+                sim.connecting = false;
+                sim.status = WL_DISCONNECTED;
+            }
+            return true;
+        }
+
+        void persistent(bool p) {
+            HostSim::current().persistent = p;
+        }
+
+        bool hostname(const char* name) {
+            HostPlatformScope platform;
+            HostSim::current().hostname = name;
+            return true;
+        }
+
+        wl_status_t begin(const char* ssid, const char* pass = NULL) {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            sim.staSsid = ssid;
+            sim.staPass = pass;
+            if (sim.persistent) {
+                sim.savedSsid = sim.staSsid;
+                sim.savedPass = sim.staPass;
+            }
+            return startConnecting(sim);
+        }
+
+        wl_status_t begin() {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            if (sim.staSsid.length() == 0) {
+                sim.staSsid = sim.savedSsid;
+                sim.staPass = sim.savedPass;
+            }
+            return startConnecting(sim);
+        }
+
+        bool disconnect() {
+            HostSim& sim = HostSim::current();
+            sim.connecting = false;
+            sim.status = WL_DISCONNECTED;
+            return true;
+        }
+
+        wl_status_t status() {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            if (sim.connecting && sim.now - sim.connectStart >= sim.connectDelay) {
+                sim.connecting = false;
+                const HostNetwork* n = sim.findNetwork(sim.staSsid);
+                if (n == NULL) {
+                    sim.status = WL_NO_SSID_AVAIL;
+                } else if (n->password != sim.staPass) {
+                    sim.status = WL_CONNECT_FAILED;
+                } else {
+                    sim.status = WL_CONNECTED;
+                }
+                sim.connectResults.push_back(sim.status);
+            }
+            return sim.status;
+        }
+
+        bool isConnected() {
+            return status() == WL_CONNECTED;
+        }
+
+        uint8_t waitForConnectResult() {
+            HostSim& sim = HostSim::current();
+            if ((sim.mode & WIFI_STA) == 0) {
+                return WL_DISCONNECTED;
+            }
+            unsigned long start = sim.now;
+            while (status() == WL_DISCONNECTED && sim.now - start < 10000) {
+                sim.advance(100);
+            }
+            return status();
+        }
+
+        String SSID() {
+            HostPlatformScope platform;
+            return HostSim::current().savedSsid;
+        }
+
+        int8_t scanNetworks() {
+            HostSim& sim = HostSim::current();
+            sim.advance(sim.scanDuration);
+            sim.scans++;
+            return (int8_t) sim.networks.size();
+        }
+
+        String SSID(uint8_t i) {
+            HostPlatformScope platform;
+            return HostSim::current().networks[i].ssid;
+        }
+
+        int32_t RSSI(uint8_t i) {
+            return HostSim::current().networks[i].rssi;
+        }
+
+        uint8_t encryptionType(uint8_t i) {
+            return HostSim::current().networks[i].encryption;
+        }
+
+        bool softAPConfig(IPAddress ip, IPAddress /* gw */, IPAddress /* sn */) {
+            HostSim::current().apIP = ip;
+            return true;
+        }
+
+        bool softAP(const char* ssid, const char* pass = NULL) {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            if (sim.persistent) {
+                sim.advance(sim.configWriteMillis);
+            }
+            sim.apName = ssid;
+            sim.apPass = pass;
+            sim.apUp = true;
+            sim.apStartAt = sim.now;
+            return true;
+        }
+
+        IPAddress softAPIP() {
+            HostSim& sim = HostSim::current();
+            return sim.apUp && sim.now - sim.apStartAt >= sim.apStartDelay ? sim.apIP : IPAddress();
+        }
+
+        uint8_t softAPgetStationNum() {
+            return HostSim::current().stations;
+        }
+
+    private:
+        wl_status_t startConnecting(HostSim& sim) {
+            sim.connecting = true;
+            sim.connectAttempts++;
+            sim.connectStart = sim.now;
+            sim.status = WL_DISCONNECTED;
+            return sim.status;
+        }
+};
+
+class HostClient {
+    public:
+        IPAddress localIP() {
+            return HostSim::current().apIP;
+        }
+
+        void stop() {}
+};
+
+/* ESP8266WebServer replacement serving the requests queued in the active HostSim */
+class HostWebServer {
+    public:
+        typedef std::function<void(void)> THandlerFunction;
+
+        HostWebServer(int port) : _port(port) {}
+
+        ~HostWebServer() {
+            HostSim::current().serverUp = false;
+        }
+
+        void on(const String& uri, THandlerFunction handler) {
+            on(uri, HTTP_ANY, handler);
+        }
+
+        /* Not a platform scope: like the core server it allocates the route for the library */
+        void on(const String& uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler = THandlerFunction()) {
+            Route route;
+            route.uri = uri;
+            route.method = method;
+            route.handler = handler;
+            route.uploadHandler = uploadHandler;
+            _routes.push_back(route);
+        }
+
+        void onNotFound(THandlerFunction handler) {
+            _notFoundHandler = handler;
+        }
+
+        void begin() {
+            HostSim& sim = HostSim::current();
+            sim.serverUp = true;
+            sim.serverUpAt = sim.now;
+        }
+
+        void stop() {
+            HostSim::current().serverUp = false;
+            _uploadRoute = NULL;
+            _uploadBody.clear();
+        }
+
+        void close() {
+            stop();
+        }
+
+        /*
+         * Serves one due request or, while a file is being uploaded, one chunk of it. Requests and
+         * upload chunks take turns so the rest of the portal keeps answering during an upload.
+         */
+        void handleClient() {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            if (!sim.serverUp) {
+                return;
+            }
+            bool requestDue = !sim.requests.empty() && sim.requests.front().at <= sim.now;
+            bool chunkDue = _uploadRoute != NULL && _nextChunkAt <= sim.now;
+            if (chunkDue && (!requestDue || !_chunkServedLast)) {
+                _chunkServedLast = true;
+                handleUploadChunk();
+            } else if (requestDue) {
+                _chunkServedLast = false;
+                _request = std::move(sim.requests.front());
+                sim.requests.pop_front();
+                _headers.clear();
+                Route* route = findRoute(_request);
+                if (route != NULL && _request.upload && route->uploadHandler && _uploadRoute == NULL) {
+                    startUpload(route);
+                    return;
+                }
+                HostLibraryScope library;
+                size_t first = sim.responses.size();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                if (route != NULL) {
+                    route->handler();
+                } else if (_notFoundHandler) {
+                    _notFoundHandler();
+                } else {
+                    send(404, "text/plain", "Not found");
+                }
+                if (sim.responses.size() > first) {
+                    sim.responses.back().handlerMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                }
+            }
+        }
+
+        HTTPUpload& upload() {
+            return _upload;
+        }
+
+        /* Returned by reference like the ESP8266 core 3 server, "" when there is none */
+        const String& arg(const String& name) {
+            HostPlatformScope platform;
+            for (size_t i = 0; i < _request.args.size(); ++i) {
+                if (_request.args[i].first == name) {
+                    return _request.args[i].second;
+                }
+            }
+            return _empty;
+        }
+
+        const String& arg(int i) {
+            return i >= 0 && i < args() ? _request.args[i].second : _empty;
+        }
+
+        const String& argName(int i) {
+            return i >= 0 && i < args() ? _request.args[i].first : _empty;
+        }
+
+        int args() {
+            return (int) _request.args.size();
+        }
+
+        bool hasArg(const String& name) {
+            for (size_t i = 0; i < _request.args.size(); ++i) {
+                if (_request.args[i].first == name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const String& uri() {
+            return _request.uri;
+        }
+
+        HTTPMethod method() {
+            return _request.method;
+        }
+
+        const String& hostHeader() {
+            return _request.host;
+        }
+
+        /* Basic auth only */
+        bool authenticate(const char* user, const char* pass) {
+            return _request.user.length() > 0 && _request.user == user && _request.pass == pass;
+        }
+
+        void requestAuthentication() {
+            HostPlatformScope platform;
+            sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+            send(401, "text/html", String());
+        }
+
+        void sendHeader(const String& name, const String& value, bool first = false) {
+            HostPlatformScope platform;
+            if (first) {
+                _headers.insert(_headers.begin(), std::make_pair(name, value));
+            } else {
+                _headers.push_back(std::make_pair(name, value));
+            }
+        }
+
+        void sendHeader(const char* name, const char* value, bool first = false) {
+            HostPlatformScope platform;
+            sendHeader(String(name), String(value), first);
+        }
+
+        void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+            HostPlatformScope platform;
+            send(code, contentType, String(std::string(content, contentLength)));
+        }
+
+        void send(int code, const char* contentType, const String& content) {
+            HostPlatformScope platform;
+            HostSim& sim = HostSim::current();
+            HostResponse r;
+            r.requestAt = _request.at;
+            r.at = sim.now;
+            r.uri = _request.uri;
+            r.code = code;
+            r.contentType = contentType;
+            r.content = content;
+            sim.responses.push_back(r);
+        }
+
+        HostClient& client() {
+            return _client;
+        }
+
+    private:
+        struct Route {
+            String              uri;
+            HTTPMethod          method;
+            THandlerFunction    handler;
+            THandlerFunction    uploadHandler;
+        };
+
+        int                                                 _port;
+        std::vector<Route>                                  _routes;
+        THandlerFunction                                    _notFoundHandler;
+        HTTPUpload                                          _upload;
+        Route*                                              _uploadRoute        = NULL;
+        HostRequest                                         _uploadRequest;
+        std::string                                         _uploadBody;
+        size_t                                              _uploadOffset       = 0;
+        unsigned long                                       _nextChunkAt        = 0;
+        bool                                                _chunkServedLast    = false;
+        std::vector<std::pair<String, String>>              _headers;
+        HostRequest                                         _request;
+        String                                              _empty;
+        HostClient                                          _client;
+
+        Route* findRoute(const HostRequest& request) {
+            for (size_t i = 0; i < _routes.size(); ++i) {
+                if (_routes[i].uri == request.uri && (_routes[i].method == HTTP_ANY || _routes[i].method == request.method)) {
+                    return &_routes[i];
+                }
+            }
+            return NULL;
+        }
+
+        void startUpload(Route* route) {
+            _uploadRoute = route;
+            _uploadBody.swap(_request.body);
+            _uploadRequest = _request;
+            _uploadOffset = 0;
+            _upload.status = UPLOAD_FILE_START;
+            _upload.filename = "firmware.bin";
+            _upload.name = "firmware";
+            _upload.type = "application/octet-stream";
+            _upload.totalSize = 0;
+            _upload.currentSize = 0;
+            _nextChunkAt = HostSim::current().now + _uploadRequest.chunkMillis;
+            HostLibraryScope library;
+            _uploadRoute->uploadHandler();
+        }
+
+        void handleUploadChunk() {
+            _request = _uploadRequest;
+            _headers.clear();
+            Route* route = _uploadRoute;
+            const std::string& body = _uploadBody;
+            if (_uploadOffset >= _uploadRequest.interruptAt) {
+                // client gone, the final handler is not called
+                _upload.status = UPLOAD_FILE_ABORTED;
+                _upload.currentSize = 0;
+                _uploadRoute = NULL;
+                _uploadBody.clear();
+                HostLibraryScope library;
+                route->uploadHandler();
+            } else if (_uploadOffset < body.size()) {
+                size_t n = body.size() - _uploadOffset;
+                n = n < HTTP_UPLOAD_BUFLEN ? n : HTTP_UPLOAD_BUFLEN;
+                n = n < _uploadRequest.interruptAt - _uploadOffset ? n : _uploadRequest.interruptAt - _uploadOffset;
+                memcpy(_upload.buf, body.data() + _uploadOffset, n);
+                _upload.status = UPLOAD_FILE_WRITE;
+                _upload.currentSize = n;
+                _upload.totalSize += n;
+                _uploadOffset += n;
+                _nextChunkAt = HostSim::current().now + _uploadRequest.chunkMillis;
+                HostLibraryScope library;
+                route->uploadHandler();
+            } else {
+                _upload.status = UPLOAD_FILE_END;
+                _upload.currentSize = 0;
+                _uploadRoute = NULL;
+                _uploadBody.clear();
+                HostLibraryScope library;
+                route->uploadHandler();
+                route->handler();
+            }
+        }
+};
+
+class HostDNSServer {
+    public:
+        ~HostDNSServer() {
+            HostSim::current().dnsUp = false;
+        }
+
+        void setErrorReplyCode(const DNSReplyCode& replyCode) {
+            _replyCode = replyCode;
+        }
+
+        bool start(const uint16_t& /* port */, const String& /* domainName */, const IPAddress& /* resolvedIP */) {
+            HostSim::current().dnsUp = true;
+            return true;
+        }
+
+        void processNextRequest() {}
+
+        void stop() {
+            HostSim::current().dnsUp = false;
+        }
+
+    private:
+        DNSReplyCode _replyCode = DNSReplyCode::NonExistentDomain;
+};
+
+/* Serial replacement, used only when LOGGING is defined */
+class HostSerial {
+    public:
+        void print(const String& s) { fputs(s.c_str(), stderr); }
+        void print(const char* s) { fputs(s, stderr); }
+        void print(const IPAddress& ip) { print(ip.toString()); }
+        template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        void print(T v) { print(String(v)); }
+        template <class T>
+        void println(const T& v) { print(v); fputc('\n', stderr); }
+};
+
+#ifdef LOGGING
+static HostSerial Serial __attribute__((unused));
+#endif
+
+/*
+ * Work stealing pool behind HostSimTraits::parallelFor. The range is split in chunks dealt round
+ * robin to one queue per worker; a worker pops chunks from the back of its own queue and steals
+ * from the front of the others once it runs dry. The calling thread works as worker 0. If the
+ * pool is already running a job (another device thread) the range just runs on the caller.
+ */
+class HostWorkQueue {
+    public:
+        typedef std::function<void(size_t, size_t)> Task;
+
+        static HostWorkQueue& shared() {
+            static HostWorkQueue queue;
+            return queue;
+        }
+
+        ~HostWorkQueue() {
+            setThreads(1);
+        }
+
+        /* Number of workers, including the calling thread. 1 runs everything sequentially */
+        void setThreads(unsigned int n) {
+            std::lock_guard<std::mutex> running(_running);
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (size_t i = 0; i < _workers.size(); ++i) {
+                _workers[i].join();
+            }
+            _workers.clear();
+            _stop = false;
+            _queues.clear();
+            for (unsigned int i = 0; i < (n > 0 ? n : 1); ++i) {
+                _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+            }
+            for (unsigned int i = 1; i < _queues.size(); ++i) {
+                _workers.push_back(std::thread(&HostWorkQueue::workerLoop, this, i));
+            }
+        }
+
+        unsigned int threads() {
+            std::lock_guard<std::mutex> running(_running);
+            return _queues.size();
+        }
+
+        /* Calls task(begin, end) over chunks covering [0, count) and returns once all are done */
+        void run(size_t count, const Task& task) {
+            std::unique_lock<std::mutex> running(_running, std::try_to_lock);
+            if (!running.owns_lock() || _queues.size() <= 1 || count <= 1) {
+                task(0, count);
+                return;
+            }
+            size_t grain = count / (_queues.size() * 4);
+            grain = grain > 0 ? grain : 1;
+            size_t chunks = (count + grain - 1) / grain;
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _task = &task;
+                _sim = &HostSim::current();
+                _pending = chunks;
+            }
+            for (size_t c = 0; c < chunks; ++c) {
+                Queue& queue = *_queues[c % _queues.size()];
+                std::lock_guard<std::mutex> lock(queue.lock);
+                queue.ranges.push_back(std::make_pair(c * grain, c * grain + grain < count ? c * grain + grain : count));
+            }
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _generation++;
+            }
+            _wake.notify_all();
+            work(0);
+            std::unique_lock<std::mutex> lock(_lock);
+            _done.wait(lock, [this]() { return _pending == 0; });
+        }
+
+    private:
+        struct Queue {
+            std::mutex                                  lock;
+            std::deque<std::pair<size_t, size_t>>       ranges;
+        };
+
+        std::mutex                              _running;   // one job at a time
+        std::mutex                              _lock;
+        std::condition_variable                 _wake;
+        std::condition_variable                 _done;
+        std::vector<std::unique_ptr<Queue>>     _queues;
+        std::vector<std::thread>                _workers;
+        const Task*                             _task       = NULL;
+        HostSim*                                _sim        = NULL;
+        size_t                                  _pending    = 0;
+        unsigned long                           _generation = 0;
+        bool                                    _stop       = false;
+
+        HostWorkQueue() {
+            _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        }
+
+        void workerLoop(unsigned int index) {
+            unsigned long seen = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(_lock);
+                    _wake.wait(lock, [&]() { return _stop || _generation != seen; });
+                    if (_stop) {
+                        return;
+                    }
+                    seen = _generation;
+                    _sim->activate();
+                }
+                work(index);
+            }
+        }
+
+        void work(unsigned int index) {
+            std::pair<size_t, size_t> range;
+            while (next(index, range)) {
+                {
+                    HostLibraryScope library;
+                    (*_task)(range.first, range.second);
+                }
+                std::lock_guard<std::mutex> lock(_lock);
+                if (--_pending == 0) {
+                    _done.notify_all();
+                }
+            }
+        }
+
+        bool next(unsigned int index, std::pair<size_t, size_t>& range) {
+            {
+                Queue& own = *_queues[index];
+                std::lock_guard<std::mutex> lock(own.lock);
+                if (!own.ranges.empty()) {
+                    range = own.ranges.back();
+                    own.ranges.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < _queues.size(); ++i) {
+                Queue& victim = *_queues[(index + i) % _queues.size()];
+                std::lock_guard<std::mutex> lock(victim.lock);
+                if (!victim.ranges.empty()) {
+                    range = victim.ranges.front();
+                    victim.ranges.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+struct HostSimTraits {
+    typedef HostWebServer   HttpServer;
+    typedef HostDNSServer   DnsServer;
+    typedef HostRadio       Radio;
+
+    static const bool       Parallel = true;    // host web server args can be read from several threads
+
+    static Radio& wifi() {
+        static HostRadio radio;
+        return radio;
+    }
+
+    static unsigned long millis() {
+        return HostSim::current().now;
+    }
+
+    static void delay(unsigned long ms) {
+        HostSim::current().advance(ms);
+    }
+
+    static void yield() {
+        HostSim::current().advance(HostSim::current().tick);
+    }
+
+    static void digitalWrite(uint8_t pin, uint8_t val) {
+        HostSim::current().pins[pin % 32] = val;
+    }
+
+    static uint32_t chipId() {
+        return HostSim::current().chipId;
+    }
+
+    static void setHostname(const char* name) {
+        wifi().hostname(name);
+    }
+
+    static void stationDisconnect() {
+        wifi().disconnect();
+    }
+
+    static bool isOpenNetwork(uint8_t encryption) {
+        return encryption == ENC_TYPE_NONE;
+    }
+
+    typedef HostUpdater     Updater;
+
+    static Updater& updater() {
+        return HostSim::current().updater;
+    }
+
+    static size_t updateSpace() {
+        return HostSim::current().flashSize;
+    }
+
+    static void abortUpdate() {
+        updater().abort();
+    }
+
+    /* Boots the staged image if there is one. Unlike the boards it returns, the caller must stop */
+    static void restart() {
+        HostSim& sim = HostSim::current();
+        sim.restarts++;
+        sim.reboot();
+    }
+
+    template <class Draft>
+    static bool loadDraft(Draft& draft) {
+        HostPlatformScope platform;
+        std::vector<uint8_t>& memory = HostSim::current().rtcMemory;
+        if (memory.size() < sizeof(Draft)) {
+            return false;
+        }
+        memcpy(&draft, memory.data(), sizeof(Draft));
+        return true;
+    }
+
+    template <class Draft>
+    static void storeDraft(const Draft& draft) {
+        HostPlatformScope platform;
+        std::vector<uint8_t>& memory = HostSim::current().rtcMemory;
+        memory.resize(sizeof(Draft));
+        memcpy(memory.data(), &draft, sizeof(Draft));
+    }
+
+    /* Runs task(begin, end) over [0, count) on the shared HostWorkQueue */
+    template <class Task>
+    static void parallelFor(size_t count, Task task) {
+        HostPlatformScope platform;
+        HostWorkQueue::shared().run(count, HostWorkQueue::Task(task));
+    }
+};
+
+#endif
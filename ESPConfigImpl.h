@@ -0,0 +1,989 @@
+#ifndef ESPConfigImpl_h
+#define ESPConfigImpl_h
+
+/*
+ * BasicESPConfig member definitions. They live in a header so any traits/memory policy combination
+ * can be instantiated; ESPConfig.cpp instantiates the default ESPConfig once for every sketch.
+ */
+
+/**
+ * Appends text to the page with the chars closing an attribute or opening markup as entities, so
+ * values typed by a client (a draft, an SSID) can not break out of the page.
+ */
+template <class Page>
+void appendEscaped(Page& page, const char* text) {
+  char chunk[33];
+  size_t n = 0;
+  for (const char* p = text; ; ++p) {
+    char c = *p;
+    const char* entity = c == '\'' ? "&#39;" : c == '"' ? "&quot;" : c == '&' ? "&amp;" : c == '<' ? "&lt;" : NULL;
+    if (c == '\0' || entity != NULL || n == sizeof(chunk) - 1) {
+      chunk[n] = '\0';
+      page.append(chunk);
+      n = 0;
+    }
+    if (c == '\0') {
+      break;
+    }
+    if (entity != NULL) {
+      page.append(entity);
+    } else {
+      chunk[n++] = c;
+    }
+  }
+}
+
+/**
+ * Appends a PROGMEM template to the page replacing every {k} placeholder, k being a char in keys,
+ * with the value in the same position, escaped unless k is in raw (custom HTML). Done in a single
+ * pass so no intermediate String is needed.
+ */
+template <class Page>
+void appendTemplate(Page& page, PGM_P tpl, const char* keys = "", const char* const* values = NULL, const char* raw = "") {
+  char chunk[33];
+  size_t n = 0;
+  for (PGM_P p = tpl; ; ++p) {
+    char c = pgm_read_byte(p);
+    char k = c == '{' ? pgm_read_byte(p + 1) : '\0';
+    const char* key = k != '\0' && pgm_read_byte(p + 2) == '}' ? strchr(keys, k) : NULL;
+    if (c == '\0' || key != NULL || n == sizeof(chunk) - 1) {
+      chunk[n] = '\0';
+      page.append(chunk);
+      n = 0;
+    }
+    if (c == '\0') {
+      break;
+    }
+    if (key != NULL) {
+      const char* value = values[key - keys];
+      if (strchr(raw, k) != NULL) {
+        page.append(value != NULL ? value : "");
+      } else {
+        appendEscaped(page, value != NULL ? value : "");
+      }
+      p += 2;
+    } else {
+      chunk[n++] = c;
+    }
+  }
+}
+
+template <class Traits, class Memory>
+BasicESPConfig<Traits, Memory>::BasicESPConfig() {
+  snprintf(_chipIdName, sizeof(_chipIdName), "%u", (unsigned int) Traits::chipId());
+  _apName = _chipIdName;
+}
+
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::connectWifiNetwork (bool existsConfig) {
+  #ifdef LOGGING
+  debug(F("Connecting to wifi network"));
+  debug(F("Previous config found"), existsConfig);
+  #endif
+  bool connected = false;
+  // a portal interrupted by a reset is reopened straight away, no saved network attempt first
+  bool resume = resumeSession();
+  while (!connected) {
+    if (existsConfig) {
+      #ifdef LOGGING
+      if (!resume) {
+        debug(F("Connecting to saved network"));
+      }
+      #endif
+      if (!resume && connectWiFi() == WL_CONNECTED) {
+        connected = true;
+      } else {
+        #ifdef LOGGING
+        if (!resume) {
+          debug(F("Could not connect to saved network. Going into config mode."));
+        }
+        #endif
+        resume = false;
+        connected = startConfigPortal();
+        if (configPortalHasTimeout()) {
+          break;
+        }
+      }
+    } else {
+      #ifdef LOGGING
+      debug(F("Going into config mode cause no config was found"));
+      #endif
+      Traits::wifi().persistent(false);
+      connected = startConfigPortal();
+    }
+  }
+  if (!connected) {
+    Traits::wifi().mode(WIFI_OFF);
+  }
+  return connected;
+}
+
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::startConfigPortal() {
+  // the AP settings are set on every portal start, no need to write them to flash
+  Traits::wifi().persistent(false);
+  Traits::wifi().mode(WIFI_AP);
+  _connect = false;
+  _restart = false;
+  if (_sessionResume) {
+    // a portal started without connectWifiNetwork() must not overwrite the draft with an empty one.
+    // It is marked to resume by the first field autosaved, an unattended portal (the saved network
+    // was down for a while) is not resumed so the saved network is tried first after a reset
+    loadDraft();
+  }
+  setupConfigPortal();
+  while(1) {
+    if (configPortalHasTimeout()) {
+      break;
+    }
+    _dnsServer->processNextRequest();
+    _server->handleClient();
+    if (_restart) {
+      // let the response reach the client before booting the new firmware
+      Traits::delay(1000);
+      #ifdef LOGGING
+      debug(F("Restarting"));
+      #endif
+      Traits::restart();
+      break;
+    }
+    if (_connect) {
+      _connect = false;
+      Traits::delay(1000);
+      #ifdef LOGGING
+      debug(F("Connecting to new AP"));
+      #endif
+      // using user-provided  _ssid, _pass in place of system-stored ssid and pass
+      //end the led feedback
+      if (_feedbackPin != INVALID_PIN_NO) {
+        //stop feedback
+        Traits::digitalWrite(_feedbackPin, LOW);
+      }
+      if (connectWifi(_server->arg(argIndex("s")).c_str(), _server->arg(argIndex("p")).c_str()) != WL_CONNECTED) {
+        #ifdef LOGGING
+        debug(F("Failed to connect."));
+        #endif
+        break;
+      } else {
+        Traits::wifi().mode(WIFI_STA);
+        //notify that configuration has changed and any optional parameters should be saved
+        if ( _savecallback != NULL) {
+          //todo: check if any custom parameters actually exist, and check if they really changed maybe
+          _savecallback();
+        }
+        break;
+      }
+    }
+    if (_feedbackPin != INVALID_PIN_NO) {
+      nonBlockingFeedback(_feedbackPin, 1000);
+    }
+    Traits::yield();
+  }
+  if (Memory::Static) {
+    // kept for the next session, so the routes are not registered again
+    _server->stop();
+    _dnsServer->stop();
+  } else {
+    _server.destroy();
+    _dnsServer.destroy();
+  }
+  bool connected = Traits::wifi().status() == WL_CONNECTED;
+  if (_sessionResume && (connected || configPortalHasTimeout())) {
+    // done with the draft once provisioned, after a time out just stop reopening the portal
+    if (connected) {
+      _draft->clear();
+    }
+    _draft->setResume(false);
+    storeDraft();
+  }
+  return connected;
+}
+
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::configPortalHasTimeout() {
+    if(_configPortalTimeout == 0 || Traits::wifi().softAPgetStationNum() > 0){
+      _configPortalStart = Traits::millis(); // kludge, bump configportal start time to skew timeouts
+      return false;
+    }
+    bool to = (Traits::millis() > _configPortalStart + _configPortalTimeout);
+    #ifdef LOGGING
+    if (to) {
+      debug(F("Config portal has timed out"));
+    }
+    #endif
+    return to;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setConfigPortalTimeout(unsigned long seconds) {
+  _configPortalTimeout = seconds * 1000;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setWifiConnectTimeout(unsigned long seconds) {
+  _wifiConnectTimeout = seconds * 1000;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setPortalSSID(const char *apName) {
+  _apName = apName;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setPortalPassword(const char *apPass) {
+  _apPass = apPass;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setMinimumSignalQuality(int quality) {
+  _minimumQuality = quality;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setAPStaticIP(IPAddress ip, IPAddress gw, IPAddress sn) {
+  _ap_static_ip = ip;
+  _ap_static_gw = gw;
+  _ap_static_sn = sn;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setFirmwareUpdate(const char* user, const char* pass) {
+  _updateUser = user;
+  _updatePass = pass;
+  _firmwareUpdate = user != NULL && pass != NULL && strlen(user) > 0 && strlen(pass) > 0;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setSessionResume(bool enabled) {
+  _sessionResume = enabled;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setFeedbackPin(uint8_t pin) {
+  _feedbackPin = pin;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setAPCallback (std::function<void(BasicESPConfig* espConfig)> callback) {
+  _apcallback = callback;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setSaveConfigCallback (std::function<void(void)> callback) {
+  _savecallback = callback;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setUpdateProgressCallback(std::function<void(size_t, size_t)> callback) {
+  _updateProgressCallback = callback;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setStationNameCallback(std::function<const char*(void)> callback) {
+  _stationNameCallback = callback;
+}
+
+template <class Traits, class Memory>
+ESPConfigParam* BasicESPConfig<Traits, Memory>::getParameter(uint16_t index) {
+  if (index >= _configParams.count()) {
+    return NULL;
+  } else {
+    return _configParams[index];
+  }
+}
+
+template <class Traits, class Memory>
+uint16_t BasicESPConfig<Traits, Memory>::getParamsCount() {
+  return _configParams.count();
+}
+
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::addParameter(ESPConfigParam *p) {
+  if (!_configParams.add(p)) {
+    #ifdef LOGGING
+    debug(F("ERROR: no room for param"), p->getName());
+    #endif
+    return false;
+  }
+  #ifdef LOGGING
+  debug(F("Adding parameter"), p->getName());
+  #endif
+  return true;
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::blockingFeedback (uint8_t pin, long stepTime, uint8_t times) {
+  for (uint8_t i = 0; i < times; ++i) {
+    Traits::digitalWrite(pin, HIGH);
+    Traits::delay(stepTime);
+    Traits::digitalWrite(pin, LOW);
+    Traits::delay(stepTime);
+  }
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::nonBlockingFeedback(uint8_t pin, int stepTime) {
+  if (Traits::millis() > _sigfbkStepControl + stepTime) {
+    _sigfbkIsOn = !_sigfbkIsOn;
+    _sigfbkStepControl = Traits::millis();
+    Traits::digitalWrite(pin, _sigfbkIsOn ? HIGH : LOW);
+  }
+}
+
+template <class Traits, class Memory>
+uint8_t BasicESPConfig<Traits, Memory>::connectWifi(const char* ssid, const char* pass) {
+  #ifdef LOGGING
+  debug(F("Connecting as wifi client..."));
+  #endif
+  if (Traits::wifi().isConnected()) {;
+    #ifdef LOGGING
+    debug(F("Already connected. Bailing out."));
+    #endif
+    return WL_CONNECTED;
+  }
+  if (_stationNameCallback) {
+    Traits::setHostname(_stationNameCallback());
+  }
+  Traits::wifi().persistent(true);
+  Traits::wifi().begin(ssid, pass);
+  Traits::wifi().persistent(false);
+  return waitForConnectResult();
+}
+
+template <class Traits, class Memory>
+uint8_t BasicESPConfig<Traits, Memory>::connectWiFi() {
+  Traits::wifi().mode(WIFI_STA);
+  if (_stationNameCallback) {
+    Traits::setHostname(_stationNameCallback());
+  }
+  if (Traits::wifi().SSID().length() > 0) {
+    #ifdef LOGGING
+    debug(F("Using last saved values, should be faster"));
+    #endif
+    Traits::stationDisconnect();
+    Traits::wifi().begin();
+    return waitForConnectResult();
+  } else {
+    #ifdef LOGGING
+    debug(F("No saved credentials"));
+    #endif
+    return WL_CONNECT_FAILED;
+  }
+}
+
+template <class Traits, class Memory>
+uint8_t BasicESPConfig<Traits, Memory>::waitForConnectResult() {
+  if (_wifiConnectTimeout == 0) {
+    return Traits::wifi().waitForConnectResult();
+  } else {
+    unsigned long start = Traits::millis();
+    bool keepConnecting = true;
+    uint8_t status;
+    #ifdef LOGGING
+    debug(F("Waiting for connection result with time out"));
+    uint8_t retry = 0;
+    #endif
+    while (keepConnecting) {
+      if (Traits::millis() > start + _wifiConnectTimeout) {
+        keepConnecting = false;
+        #ifdef LOGGING
+        debug(F("Connection timed out"));
+        #endif
+      }
+      status = Traits::wifi().status();
+      if (status == WL_CONNECTED) {
+        keepConnecting = false;
+      } else if (status == WL_NO_SSID_AVAIL) { // in case configured SSID cannot be reached
+        #ifdef LOGGING
+        debug(F("Connection failed. SSID provided not available"), Traits::wifi().SSID());
+        debug(F("Retrying"), ++retry);
+        #endif
+        Traits::wifi().begin();
+      } else if (status == WL_IDLE_STATUS) { // when Wi-Fi is in process of changing between statuses
+        #ifdef LOGGING
+        debug(F("Status IDLE. Waiting to final state"));
+        #endif
+        Traits::delay(500);
+      } else if (status == WL_CONNECT_FAILED) { // if password is incorrect
+        #ifdef LOGGING
+        debug(F("Credentials provided wrong. Stop trying to connect"));
+        #endif
+        keepConnecting = false;
+      }
+      Traits::delay(100);
+    }
+    return status;
+  }
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::setupConfigPortal() {
+  if (!_dnsServer) {
+    _dnsServer.create();
+  }
+  #ifdef LOGGING
+  debug(F("Configuring access point... "), _apName);
+  #endif
+  if (_apPass != NULL) {
+    if (strlen(_apPass) < 8 || strlen(_apPass) > 63) {
+      #ifdef LOGGING
+      debug(F("Invalid AccessPoint password. Ignoring"));
+      #endif
+      _apPass = NULL;
+    }
+    #ifdef LOGGING
+    debug(_apPass);
+    #endif
+  }
+  if (_firmwareUpdate && _apPass == NULL) {
+    // anyone in range could join an open portal and flash it
+    #ifdef LOGGING
+    debug(F("Firmware update needs a portal password. Disabled"));
+    #endif
+    _firmwareUpdate = false;
+  }
+  if (_ap_static_ip) {
+    #ifdef LOGGING
+    debug(F("Custom AP IP/GW/Subnet"));
+    #endif
+    Traits::wifi().softAPConfig(_ap_static_ip, _ap_static_gw, _ap_static_sn);
+  }
+  if (_apPass != NULL) {
+    Traits::wifi().softAP(_apName, _apPass);
+  } else {
+    Traits::wifi().softAP(_apName);
+  }
+  // The IP address is blank for a while after the AP starts, wait for it (500 ms at most)
+  unsigned long apStart = Traits::millis();
+  while (!Traits::wifi().softAPIP() && Traits::millis() - apStart < 500) {
+    Traits::delay(10);
+  }
+  #ifdef LOGGING
+  debug(F("AP IP address"), Traits::wifi().softAPIP());
+  #endif
+  /* Setup the DNS server redirecting all the domains to the apIP */
+  _dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
+  _dnsServer->start(DNS_PORT, "*", Traits::wifi().softAPIP());
+  /* Setup web pages, once per server. The optional pages check their setting when requested */
+  /* Handlers only capture this so they fit in std::function without allocating */
+  if (!_server) {
+    _server.create(80);
+    _server->on("/", [this]() { handleWifi(false); });
+    _server->on("/config", [this]() { handleWifi(false); });
+    _server->on("/scan", [this]() { handleWifi(true); });
+    _server->on("/wifisave", [this]() { handleWifiSave(); });
+    _server->on("/draft", [this]() { handleDraft(); });
+    _server->on("/update", HTTP_GET, [this]() { handleUpdate(); });
+    _server->on("/update", HTTP_POST, [this]() { handleUpdateDone(); }, [this]() { handleUpdateUpload(); });
+    _server->onNotFound([this]() { handleNotFound(); });
+  }
+  _configPortalStart = Traits::millis();
+  _server->begin();
+  #ifdef LOGGING
+  debug(F("HTTP server started"));
+  #endif
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleWifi(bool scan) {
+  // If captive portal redirect instead of displaying the page.
+  if (captivePortal()) { 
+    return;
+  }
+  appendHead("Proeza Domotics");
+  if (scan) {
+    int n = Traits::wifi().scanNetworks();
+    #ifdef LOGGING
+    debug(F("Scan done"));
+    #endif
+    if (n <= 0) {
+      #ifdef LOGGING
+      debug(F("No networks found"));
+      #endif
+      appendTemplate(_page, HTTP_NO_NETWORKS);
+    } else {
+      // sort networks keeping the strongest ones (all of them unless the memory policy caps it)
+      int limit = Memory::MaxScanEntries > 0 && n > Memory::MaxScanEntries ? Memory::MaxScanEntries : n;
+      int indices[limit];
+      int count = 0;
+      for (int i = 0; i < n; i++) {
+        int rssi = Traits::wifi().RSSI(i);
+        int pos = count;
+        while (pos > 0 && Traits::wifi().RSSI(indices[pos - 1]) < rssi) {
+          pos--;
+        }
+        if (pos >= limit) {
+          continue;
+        }
+        if (count < limit) {
+          count++;
+        }
+        for (int j = count - 1; j > pos; j--) {
+          indices[j] = indices[j - 1];
+        }
+        indices[pos] = i;
+      }
+      // remove duplicates ( must be RSSI sorted )
+      for (int i = 0; i < count; i++) {
+        if (indices[i] == -1) continue;
+        for (int j = i + 1; j < count; j++) {
+          if (indices[j] != -1 && Traits::wifi().SSID(indices[i]) == Traits::wifi().SSID(indices[j])) {
+            #ifdef LOGGING
+            debug(F("DUP AP"), Traits::wifi().SSID(indices[j]));
+            #endif
+            indices[j] = -1; // set dup aps to index -1
+          }
+        }
+      }
+      //display networks in page
+      char rssiQ[5];
+      for (int i = 0; i < count; i++) {
+        if (indices[i] == -1) continue; // skip dups
+        #ifdef LOGGING
+        debug(Traits::wifi().SSID(indices[i]));
+        debug(Traits::wifi().RSSI(indices[i]));
+        #endif
+        int quality = getRSSIasQuality(Traits::wifi().RSSI(indices[i]));
+        if (_minimumQuality == -1 || _minimumQuality < quality) {
+          String ssid = Traits::wifi().SSID(indices[i]);
+          snprintf(rssiQ, sizeof(rssiQ), "%d", quality);
+          const char* item[] = {ssid.c_str(), rssiQ, Traits::isOpenNetwork(Traits::wifi().encryptionType(indices[i])) ? "" : "l"};
+          appendTemplate(_page, HTTP_ITEM, "vri", item);
+        } else {
+          #ifdef LOGGING
+          debug(F("Skipping due to quality"));
+          #endif
+        }
+      }
+      _page.append("<br/>");
+    }
+  }
+  const char* ssid[] = {_draft ? _draft->get("s") : NULL};
+  appendTemplate(_page, HTTP_FORM_START, "v", ssid);
+  // add the extra parameters to the form
+  appendParams();
+  appendTemplate(_page, HTTP_FORM_END);
+  if (_sessionResume) {
+    appendTemplate(_page, HTTP_FORM_DRAFT);
+  }
+  appendTemplate(_page, HTTP_SCAN_LINK);
+  if (_firmwareUpdate) {
+    appendTemplate(_page, HTTP_UPDATE_LINK);
+  }
+  appendTemplate(_page, HTTP_END);
+  sendPage(200, "text/html");
+  #ifdef LOGGING
+  debug(F("Sent config page"));
+  #endif
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleNotFound() {
+  // If captive portal redirect instead of displaying the error page.
+  if (captivePortal()) { 
+    return;
+  }
+  char number[6];
+  _page.clear();
+  _page.append("File Not Found\n\n");
+  _page.append("URI: ");
+  _page.append(_server->uri().c_str());
+  _page.append("\nMethod: ");
+  _page.append(_server->method() == HTTP_GET ? "GET" : "POST");
+  _page.append("\nArguments: ");
+  snprintf(number, sizeof(number), "%d", _server->args());
+  _page.append(number);
+  _page.append("\n");
+  for (int i = 0; i < _server->args(); i++) {
+    _page.append(" ");
+    _page.append(_server->argName(i).c_str());
+    _page.append(": ");
+    _page.append(_server->arg(i).c_str());
+    _page.append("\n");
+  }
+  _server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+  _server->sendHeader("Pragma", "no-cache");
+  _server->sendHeader("Expires", "-1");
+  sendPage(404, "text/plain");
+}
+
+/** Handle the WLAN save form and redirect to WLAN config page again */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleWifiSave() {
+  saveParams();
+  if (_sessionResume) {
+    // kept until connected, a reset or a wrong password brings the form back filled. The network
+    // just sent is tried first after a reset, so it is not a portal to resume anymore
+    _draft->set("s", _server->arg(argIndex("s")).c_str());
+    for (uint16_t i = 0; i < _configParams.count(); i++) {
+      _draft->set(_configParams[i]->getName(), _configParams[i]->getValue());
+    }
+    _draft->setResume(false);
+    storeDraft();
+  }
+  appendHead("Credentials Saved");
+  appendTemplate(_page, HTTP_SAVED);
+  appendTemplate(_page, HTTP_END);
+  sendPage(200, "text/html");
+  _connect = true; //signal ready to connect/reset
+}
+
+/** Autosaves the form fields sent (the page does it on every change) */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleDraft() {
+  if (!_sessionResume) {
+    handleNotFound();
+    return;
+  }
+  for (int i = 0; i < _server->args(); i++) {
+    const String& name = _server->argName(i);
+    bool known = name == "s";
+    for (uint16_t j = 0; j < _configParams.count() && !known; j++) {
+      known = name == _configParams[j]->getName();
+    }
+    if (known && !_draft->set(name.c_str(), _server->arg(i).c_str())) {
+      #ifdef LOGGING
+      debug(F("No room in draft for"), name);
+      #endif
+    }
+  }
+  _draft->setResume(true);
+  storeDraft();
+  _server->send(204, "text/plain", "");
+}
+
+/**
+ * Creates the draft and reads the one left by a previous boot into it. Only the first time, so the
+ * fields sent since are kept, and only with session resume so the draft costs nothing otherwise.
+ */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::loadDraft() {
+  if (_draft) {
+    return;
+  }
+  _draft.create();
+  if (!Traits::loadDraft(*_draft) || !_draft->valid()) {
+    _draft->clear();
+  }
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::storeDraft() {
+  Traits::storeDraft(*_draft);
+}
+
+/** True if the portal of a previous boot was interrupted */
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::resumeSession() {
+  if (!_sessionResume) {
+    return false;
+  }
+  loadDraft();
+  #ifdef LOGGING
+  if (_draft->resume()) {
+    debug(F("Resuming interrupted config portal"));
+  }
+  #endif
+  return _draft->resume();
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleUpdate() {
+  if (!_firmwareUpdate) {
+    handleNotFound();
+    return;
+  }
+  if (captivePortal()) {
+    return;
+  }
+  if (!_server->authenticate(_updateUser, _updatePass)) {
+    _server->requestAuthentication();
+    return;
+  }
+  appendHead("Firmware update");
+  appendTemplate(_page, HTTP_UPDATE_FORM);
+  appendTemplate(_page, HTTP_END);
+  sendPage(200, "text/html");
+}
+
+/**
+ * Streams the uploaded image into the updater chunk by chunk, so only the updater sector buffer is
+ * held in RAM. The image is verified when the upload ends and only then marked to boot, otherwise
+ * the running firmware stays. Without the credentials the updater is not started, so the chunks are
+ * dropped.
+ */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleUpdateUpload() {
+  if (!_firmwareUpdate) {
+    return;
+  }
+  typename Traits::Updater& updater = Traits::updater();
+  HTTPUpload& upload = _server->upload();
+  if (upload.status == UPLOAD_FILE_START && !_server->authenticate(_updateUser, _updatePass)) {
+    #ifdef LOGGING
+    debug(F("Firmware update not authorized"));
+    #endif
+    _updateOk = false;
+  } else if (upload.status == UPLOAD_FILE_START) {
+    #ifdef LOGGING
+    debug(F("Firmware update started"), upload.filename);
+    #endif
+    _updateOk = false;
+    _updateError = UPDATE_ERROR_OK;
+    _updateSize = strtoul(_server->arg(argIndex("size")).c_str(), NULL, 10);
+    size_t space = Traits::updateSpace();
+    if (updater.begin(_updateSize > 0 && _updateSize <= space ? _updateSize : space)) {
+      const String& md5 = _server->arg(argIndex("md5"));
+      if (md5.length() > 0 && !updater.setMD5(md5.c_str())) {
+        #ifdef LOGGING
+        debug(F("Invalid MD5"), md5);
+        #endif
+        _updateError = UPDATE_ERROR_MD5;
+        Traits::abortUpdate();
+      }
+    }
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    if (updater.isRunning() && updater.write(upload.buf, upload.currentSize) != upload.currentSize) {
+      #ifdef LOGGING
+      debug(F("Firmware write failed"), updater.getError());
+      #endif
+    }
+    // nothing to report once the update stopped (not authorized, invalid MD5, write failed)
+    if (updater.isRunning() && _updateProgressCallback) {
+      _updateProgressCallback(updater.progress(), _updateSize);
+    }
+  } else if (upload.status == UPLOAD_FILE_END) {
+    if (_sessionResume && updater.isRunning()) {
+      // the portal is not reopened after the restart. Written before end(), on ESP8266 that writes
+      // the command booting the image to RTC memory as well and nothing may touch it after
+      _draft->setResume(false);
+      storeDraft();
+    }
+    _updateOk = updater.end(true);
+    #ifdef LOGGING
+    if (!_updateOk) {
+      debug(F("Firmware update failed"), updater.getError());
+    }
+    #endif
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    #ifdef LOGGING
+    debug(F("Firmware upload aborted"));
+    #endif
+    Traits::abortUpdate();
+  }
+  // the web server reads the whole upload in one go, keep answering DNS meanwhile
+  _dnsServer->processNextRequest();
+  Traits::yield();
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::handleUpdateDone() {
+  if (!_firmwareUpdate) {
+    handleNotFound();
+    return;
+  }
+  if (!_server->authenticate(_updateUser, _updatePass)) {
+    _server->requestAuthentication();
+    return;
+  }
+  if (_updateOk) {
+    appendHead("Firmware update");
+    appendTemplate(_page, HTTP_UPDATE_DONE);
+    appendTemplate(_page, HTTP_END);
+    sendPage(200, "text/html");
+    _restart = true;
+  } else {
+    char error[4];
+    snprintf(error, sizeof(error), "%u", (unsigned int) (_updateError != UPDATE_ERROR_OK ? _updateError : Traits::updater().getError()));
+    const char* failure[] = {error};
+    appendHead("Firmware update");
+    appendTemplate(_page, HTTP_UPDATE_FAILED, "e", failure);
+    appendTemplate(_page, HTTP_END);
+    sendPage(500, "text/html");
+  }
+}
+
+/** Starts a page with the common head and the title given */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::appendHead(const char* title) {
+  const char* values[] = {title};
+  _page.clear();
+  appendTemplate(_page, HTTP_HEADER, "v", values);
+  appendTemplate(_page, HTTP_SCRIPT);
+  appendTemplate(_page, HTTP_STYLE);
+  appendTemplate(_page, HTTP_TITLE);
+  appendTemplate(_page, HTTP_HEADER_END);
+}
+
+/**
+ * Appends the params to the form. Where the platform runs work in parallel (and pages live on the
+ * heap) long lists are rendered in fragments on several threads and stitched back in order.
+ */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::appendParams() {
+  uint16_t count = _configParams.count();
+  if (!Traits::Parallel || Memory::Static || count < 2 * ESP_CONFIG_PARAMS_GRAIN) {
+    renderParams(_page, 0, count);
+    return;
+  }
+  size_t fragments = (count + ESP_CONFIG_PARAMS_GRAIN - 1) / ESP_CONFIG_PARAMS_GRAIN;
+  std::vector<typename Memory::Page> pages(fragments);
+  Traits::parallelFor(fragments, [this, count, &pages](size_t begin, size_t end) {
+    for (size_t f = begin; f < end; ++f) {
+      uint16_t to = (f + 1) * ESP_CONFIG_PARAMS_GRAIN < count ? (f + 1) * ESP_CONFIG_PARAMS_GRAIN : count;
+      renderParams(pages[f], f * ESP_CONFIG_PARAMS_GRAIN, to);
+    }
+  });
+  for (size_t f = 0; f < fragments; ++f) {
+    _page.append(pages[f].c_str());
+  }
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::renderParams(typename Memory::Page& page, uint16_t from, uint16_t to) {
+  char parLength[5];
+  for (uint16_t i = from; i < to; i++) {
+    ESPConfigParam* param = _configParams[i];
+    if (param->getName() != NULL) {
+      if (param->getType() == Combo) {
+        const char* pitem[] = {param->getName(), param->getName(), param->getLabel(), param->getCustomHTML()};
+        appendTemplate(page, HTTP_FORM_INPUT_LIST, "inpc", pitem, "c");
+        for (size_t j = 0; j < param->getOptions().size(); ++j) {
+          const char* op[] = {param->getOptions()[j]};
+          appendTemplate(page, HTTP_FORM_INPUT_LIST_OPTION, "o", op);
+        }
+        appendTemplate(page, HTTP_FORM_INPUT_LIST_END);
+      } else {
+        snprintf(parLength, 5, "%d", param->getValueLength());
+        const char* value = _draft ? _draft->get(param->getName()) : NULL;
+        const char* pitem[] = {param->getName(), param->getName(), param->getLabel(), parLength, value != NULL ? value : param->getValue(), param->getCustomHTML()};
+        appendTemplate(page, HTTP_FORM_INPUT, "inplvc", pitem, "c");
+      }
+    } 
+  }
+}
+
+/**
+ * Takes the params values from the submitted form, in parallel fragments where the platform allows
+ * it and, as when rendering, only with heap memory.
+ */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::saveParams() {
+  uint16_t count = _configParams.count();
+  if (!Traits::Parallel || Memory::Static || count < 2 * ESP_CONFIG_PARAMS_GRAIN) {
+    updateParams(0, count);
+    return;
+  }
+  size_t fragments = (count + ESP_CONFIG_PARAMS_GRAIN - 1) / ESP_CONFIG_PARAMS_GRAIN;
+  Traits::parallelFor(fragments, [this, count](size_t begin, size_t end) {
+    uint16_t to = end * ESP_CONFIG_PARAMS_GRAIN < count ? end * ESP_CONFIG_PARAMS_GRAIN : count;
+    updateParams(begin * ESP_CONFIG_PARAMS_GRAIN, to);
+  });
+}
+
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::updateParams(uint16_t from, uint16_t to) {
+  for (uint16_t i = from; i < to; i++) {
+    _configParams[i]->updateValue(_server->arg(argIndex(_configParams[i]->getName())).c_str());
+    #ifdef LOGGING
+    debug(_configParams[i]->getName(), _configParams[i]->getValue());
+    #endif
+  }
+}
+
+/**
+ * Index of the form field name, or args() when it was not sent (arg() returns "" for it). Finding it
+ * by index means no String is built from name.
+ */
+template <class Traits, class Memory>
+int BasicESPConfig<Traits, Memory>::argIndex(const char* name) {
+  int count = _server->args();
+  for (int i = 0; i < count; i++) {
+    if (_server->argName(i) == name) {
+      return i;
+    }
+  }
+  return count;
+}
+
+/** Sends the page rendered in _page and releases it */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::sendPage(int code, const char* contentType) {
+  if (_page.overflowed()) {
+    #ifdef LOGGING
+    debug(F("Page truncated, increase ESP_CONFIG_RENDER_BUFFER"), _page.length());
+    #endif
+    _page.clear();
+    _page.append("Page too large");
+    code = 500;
+    contentType = "text/plain";
+  }
+  _server->send_P(code, contentType, _page.c_str(), _page.length());
+  _page.clear();
+}
+
+/** Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again. */
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::captivePortal() {
+  if (!isIp(_server->hostHeader()) ) {
+    #ifdef LOGGING
+    debug(F("Request redirected to captive portal"));
+    #endif
+    char location[24] = "http://";
+    toStringIp(_server->client().localIP(), location + 7, sizeof(location) - 7);
+    _server->sendHeader("Location", location, true);
+    _server->send(302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
+    _server->client().stop(); // Stop is needed because we sent no content length
+    return true;
+  }
+  return false;
+}
+
+template <class Traits, class Memory>
+bool BasicESPConfig<Traits, Memory>::isIp(const String& str) {
+  for (unsigned int i = 0; i < str.length(); i++) {
+    char c = str.charAt(i);
+    if (c != '.' && (c < '0' || c > '9')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** IP to String? */
+template <class Traits, class Memory>
+void BasicESPConfig<Traits, Memory>::toStringIp(IPAddress ip, char* buffer, size_t size) {
+  uint32_t address = ip;
+  snprintf(buffer, size, "%u.%u.%u.%u", (unsigned int) (address & 0xFF), (unsigned int) ((address >> 8) & 0xFF), (unsigned int) ((address >> 16) & 0xFF), (unsigned int) ((address >> 24) & 0xFF));
+}
+
+template <class Traits, class Memory>
+int BasicESPConfig<Traits, Memory>::getRSSIasQuality(int RSSI) {
+  int quality = 0;
+  if (RSSI <= -100) {
+    quality = 0;
+  } else if (RSSI >= -50) {
+    quality = 100;
+  } else {
+    quality = 2 * (RSSI + 100);
+  }
+  return quality;
+}
+
+#ifdef LOGGING
+template <class Traits, class Memory>
+template <class T> void BasicESPConfig<Traits, Memory>::debug (T text) {
+  Serial.print("*CONF: ");
+  Serial.println(text);
+}
+
+template <class Traits, class Memory>
+template <class T, class U> void BasicESPConfig<Traits, Memory>::debug (T key, U value) {
+  Serial.print("*CONF: ");
+  Serial.print(key);
+  Serial.print(": ");
+  Serial.println(value);
+}
+#endif
+
+#endif
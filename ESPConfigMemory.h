@@ -0,0 +1,199 @@
+#ifndef ESPConfigMemory_h
+#define ESPConfigMemory_h
+
+/*
+ * Memory policies. They decide where BasicESPConfig keeps its params table, the portal web/dns
+ * servers, the pages it renders and the session draft. The draft size is a template argument so
+ * config objects with different drafts are different types.
+ *
+ * ESPConfigHeapMemory     grows on demand, servers are created per portal session and the draft
+ *                         only when session resume is used (default).
+ * ESPConfigStaticMemory   everything is sized at compile time and lives inside the config object,
+ *                         so the library keeps no heap buffers of its own.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ESPConfigDraft.h"
+
+class ESPConfigParam;
+
+/* Page rendered into a String that is released once sent */
+class ESPConfigHeapPage {
+    public:
+        void        append(const char* s) { _s += s; }
+        void        clear() { _s = String(); }
+        const char* c_str() const { return _s.c_str(); }
+        size_t      length() const { return _s.length(); }
+        bool        overflowed() const { return false; }
+
+    private:
+        String      _s;
+};
+
+/* Page rendered into a fixed buffer, content not fitting is dropped and flagged */
+template <size_t Size>
+class ESPConfigStaticPage {
+    public:
+        ESPConfigStaticPage() { clear(); }
+
+        void append(const char* s) {
+            size_t n = strlen(s);
+            if (_length + n >= Size) {
+                n = Size - 1 - _length;
+                _overflowed = true;
+            }
+            memcpy(_buffer + _length, s, n);
+            _length += n;
+            _buffer[_length] = '\0';
+        }
+
+        void        clear() { _length = 0; _buffer[0] = '\0'; _overflowed = false; }
+        const char* c_str() const { return _buffer; }
+        size_t      length() const { return _length; }
+        bool        overflowed() const { return _overflowed; }
+
+    private:
+        char        _buffer[Size];
+        size_t      _length;
+        bool        _overflowed;
+};
+
+/* Params table backed by a heap array, grows by ESP_CONFIG_MAX_PARAMS when full */
+class ESPConfigHeapParams {
+    public:
+        ESPConfigHeapParams() {
+            _max = ESP_CONFIG_MAX_PARAMS;
+            _params = (ESPConfigParam**)malloc(_max * sizeof(ESPConfigParam*));
+        }
+
+        ~ESPConfigHeapParams() {
+            if (_params != NULL) {
+                free(_params);
+            }
+        }
+
+        // owns the array, a copy would free it twice
+        ESPConfigHeapParams(const ESPConfigHeapParams&) = delete;
+        ESPConfigHeapParams& operator=(const ESPConfigHeapParams&) = delete;
+
+        bool add(ESPConfigParam* p) {
+            if (_count + 1 > _max) {
+                // rezise the params array
+                ESPConfigParam** newParams = (ESPConfigParam**)realloc(_params, (_max + ESP_CONFIG_MAX_PARAMS) * sizeof(ESPConfigParam*));
+                if (newParams == NULL) {
+                    return false;
+                }
+                _params = newParams;
+                _max += ESP_CONFIG_MAX_PARAMS;
+            }
+            _params[_count++] = p;
+            return true;
+        }
+
+        ESPConfigParam* operator[](uint16_t i) const { return _params[i]; }
+        uint16_t        count() const { return _count; }
+
+    private:
+        ESPConfigParam**    _params;
+        uint16_t            _max;
+        uint16_t            _count = 0;
+};
+
+template <uint16_t MaxParams>
+class ESPConfigStaticParams {
+    public:
+        bool add(ESPConfigParam* p) {
+            if (_count >= MaxParams) {
+                return false;
+            }
+            _params[_count++] = p;
+            return true;
+        }
+
+        ESPConfigParam* operator[](uint16_t i) const { return _params[i]; }
+        uint16_t        count() const { return _count; }
+
+    private:
+        ESPConfigParam*     _params[MaxParams];
+        uint16_t            _count = 0;
+};
+
+/* Holds an object created on demand (the portal servers) on the heap */
+template <class T>
+class ESPConfigHeapSlot {
+    public:
+        template <class... Args>
+        void create(Args&&... args) { _object.reset(new T(std::forward<Args>(args)...)); }
+        void destroy() { _object.reset(); }
+        T*   operator->() { return _object.get(); }
+        T&   operator*() { return *_object; }
+        explicit operator bool() const { return _object != nullptr; }
+
+    private:
+        std::unique_ptr<T>  _object;
+};
+
+/* Holds an object created on demand inside a buffer reserved up front */
+template <class T>
+class ESPConfigStaticSlot {
+    public:
+        ESPConfigStaticSlot() = default;
+        ~ESPConfigStaticSlot() { destroy(); }
+
+        // _object points into this slot's own storage, a copy would destroy the object twice
+        ESPConfigStaticSlot(const ESPConfigStaticSlot&) = delete;
+        ESPConfigStaticSlot& operator=(const ESPConfigStaticSlot&) = delete;
+
+        template <class... Args>
+        void create(Args&&... args) {
+            destroy();
+            _object = new (&_storage) T(std::forward<Args>(args)...);
+        }
+
+        void destroy() {
+            if (_object != NULL) {
+                _object->~T();
+                _object = NULL;
+            }
+        }
+
+        T*   operator->() { return _object; }
+        T&   operator*() { return *_object; }
+        explicit operator bool() const { return _object != NULL; }
+
+    private:
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+        T*  _object = NULL;
+};
+
+template <size_t DraftSize = ESP_CONFIG_DRAFT_SIZE>
+struct ESPConfigHeapMemory {
+    static const bool       Static          = false;
+    static const uint8_t    MaxScanEntries  = 0;    // all the networks found are listed
+
+    typedef ESPConfigHeapParams         Params;
+    typedef ESPConfigHeapPage           Page;
+    typedef ESPConfigDraft<DraftSize>   Draft;
+    template <class T> using Slot = ESPConfigHeapSlot<T>;
+};
+
+template <uint16_t MaxParams, uint8_t MaxScan, size_t RenderBufferSize, size_t DraftSize = ESP_CONFIG_DRAFT_SIZE>
+struct ESPConfigStaticMemory {
+    static const bool       Static          = true;
+    static const uint8_t    MaxScanEntries  = MaxScan;  // strongest networks kept from a scan
+
+    typedef ESPConfigStaticParams<MaxParams>        Params;
+    typedef ESPConfigStaticPage<RenderBufferSize>   Page;
+    typedef ESPConfigDraft<DraftSize>               Draft;
+    template <class T> using Slot = ESPConfigStaticSlot<T>;
+};
+
+#endif
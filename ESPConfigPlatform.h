@@ -0,0 +1,235 @@
+#ifndef ESPConfigPlatform_h
+#define ESPConfigPlatform_h
+
+/*
+ * Platform traits. Each traits struct tells BasicESPConfig which web/dns server types to use
+ * and how to reach the radio, the clock, the pins and the few SDK calls the library needs.
+ * Everything is static so the compiler resolves the calls with no runtime dispatch.
+ * Parallel tells whether parallelFor really spreads work over threads; when it does, the web
+ * server args must be readable from several threads at once.
+ * Updater is the object firmware images are streamed into (the core Update object on the boards);
+ * restart() boots whatever image it left verified, or the running one after a failed update.
+ * loadDraft()/storeDraft() keep the portal form draft in memory surviving resets (not power loss).
+ *
+ * ESPConfigDefaultTraits is the traits struct of the platform being compiled for.
+ */
+
+#if defined(ESP8266)
+
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <DNSServer.h>
+#include <Updater.h>
+
+extern "C" {
+  #include "user_interface.h"
+}
+
+/*
+ * First 4 byte block of the RTC user memory used for the portal draft. Only the first 64 blocks
+ * (256 bytes) are free: from block 64 on the core keeps the eboot command that copies a verified
+ * OTA image on restart.
+ */
+#ifndef ESP_CONFIG_DRAFT_RTC_BLOCK
+#define ESP_CONFIG_DRAFT_RTC_BLOCK 0
+#endif
+
+struct Esp8266Traits {
+    typedef ESP8266WebServer    HttpServer;
+    typedef DNSServer           DnsServer;
+    typedef ESP8266WiFiClass    Radio;
+
+    static const bool           Parallel = false;
+
+    static Radio& wifi() {
+        return WiFi;
+    }
+
+    static unsigned long millis() {
+        return ::millis();
+    }
+
+    static void delay(unsigned long ms) {
+        ::delay(ms);
+    }
+
+    static void yield() {
+        ::yield();
+    }
+
+    static void digitalWrite(uint8_t pin, uint8_t val) {
+        ::digitalWrite(pin, val);
+    }
+
+    static uint32_t chipId() {
+        return ESP.getChipId();
+    }
+
+    static void setHostname(const char* name) {
+        WiFi.hostname(name);
+    }
+
+    static void stationDisconnect() {
+        //trying to fix connection in progress hanging
+        ETS_UART_INTR_DISABLE();
+        wifi_station_disconnect();
+        ETS_UART_INTR_ENABLE();
+    }
+
+    static bool isOpenNetwork(uint8_t encryption) {
+        return encryption == ENC_TYPE_NONE;
+    }
+
+    typedef UpdaterClass        Updater;
+
+    static Updater& updater() {
+        return Update;
+    }
+
+    // same room ESP8266HTTPUpdateServer gives the new sketch
+    static size_t updateSpace() {
+        return (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    }
+
+    // the updater has no abort, ending it short discards the image
+    static void abortUpdate() {
+        Update.end(false);
+    }
+
+    static void restart() {
+        ESP.restart();
+    }
+
+    template <class Draft>
+    static bool loadDraft(Draft& draft) {
+        static_assert(ESP_CONFIG_DRAFT_RTC_BLOCK * 4 + sizeof(Draft) <= 256, "The draft overlaps the eboot command in RTC memory");
+        return ESP.rtcUserMemoryRead(ESP_CONFIG_DRAFT_RTC_BLOCK, (uint32_t*) &draft, sizeof(Draft));
+    }
+
+    template <class Draft>
+    static void storeDraft(const Draft& draft) {
+        static_assert(ESP_CONFIG_DRAFT_RTC_BLOCK * 4 + sizeof(Draft) <= 256, "The draft overlaps the eboot command in RTC memory");
+        ESP.rtcUserMemoryWrite(ESP_CONFIG_DRAFT_RTC_BLOCK, (uint32_t*) &draft, sizeof(Draft));
+    }
+
+    // single core, the work runs in order on the calling thread
+    template <class Task>
+    static void parallelFor(size_t count, Task task) {
+        task(0, count);
+    }
+};
+
+typedef Esp8266Traits ESPConfigDefaultTraits;
+
+#elif defined(ESP32)
+
+#include <WiFi.h>
+#include <WebServer.h>
+#include <DNSServer.h>
+#include <Update.h>
+
+struct Esp32Traits {
+    typedef WebServer   HttpServer;
+    typedef DNSServer   DnsServer;
+    typedef WiFiClass   Radio;
+
+    static const bool   Parallel = false;
+
+    static Radio& wifi() {
+        return WiFi;
+    }
+
+    static unsigned long millis() {
+        return ::millis();
+    }
+
+    static void delay(unsigned long ms) {
+        ::delay(ms);
+    }
+
+    static void yield() {
+        ::yield();
+    }
+
+    static void digitalWrite(uint8_t pin, uint8_t val) {
+        ::digitalWrite(pin, val);
+    }
+
+    static uint32_t chipId() {
+        // the three lower bytes of the MAC, same as ESP8266 getChipId
+        uint64_t mac = ESP.getEfuseMac();
+        return (uint32_t) ((mac >> 24) & 0xFFFFFF);
+    }
+
+    static void setHostname(const char* name) {
+        WiFi.setHostname(name);
+    }
+
+    static void stationDisconnect() {
+        WiFi.disconnect();
+    }
+
+    static bool isOpenNetwork(uint8_t encryption) {
+        return encryption == WIFI_AUTH_OPEN;
+    }
+
+    typedef UpdateClass Updater;
+
+    static Updater& updater() {
+        return Update;
+    }
+
+    // the whole OTA partition
+    static size_t updateSpace() {
+        return UPDATE_SIZE_UNKNOWN;
+    }
+
+    static void abortUpdate() {
+        Update.abort();
+    }
+
+    static void restart() {
+        ESP.restart();
+    }
+
+    template <class Draft>
+    static bool loadDraft(Draft& draft) {
+        memcpy(&draft, rtcDraft<Draft>(), sizeof(Draft));
+        return true;
+    }
+
+    template <class Draft>
+    static void storeDraft(const Draft& draft) {
+        memcpy(rtcDraft<Draft>(), &draft, sizeof(Draft));
+    }
+
+    // RTC slow memory left untouched by the boot code, it keeps its content across resets
+    template <class Draft>
+    static uint8_t* rtcDraft() {
+        RTC_NOINIT_ATTR static uint32_t memory[sizeof(Draft) / 4];
+        return (uint8_t*) memory;
+    }
+
+    // the web server is not thread safe, the work runs in order on the calling thread
+    template <class Task>
+    static void parallelFor(size_t count, Task task) {
+        task(0, count);
+    }
+};
+
+typedef Esp32Traits ESPConfigDefaultTraits;
+
+#elif !defined(ARDUINO)
+
+/* Host builds (the simulators in extras/), ESPConfigHost.h stands in for the Arduino core */
+#include "ESPConfigHost.h"
+
+typedef HostSimTraits ESPConfigDefaultTraits;
+
+#else
+
+#error "ESPConfig only supports the ESP8266 and ESP32 cores"
+
+#endif
+
+#endif
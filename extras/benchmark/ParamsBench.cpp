@@ -0,0 +1,99 @@
+/*
+ * Params rendering and saving benchmark for host builds.
+ *
+ * Serves the config page and the save form of a portal with 100 to 1000 params while the shared
+ * HostWorkQueue runs with 1 to 8 threads, and reports the wall time the page handlers take per
+ * request (HostResponse::handlerMillis), so the portal start, the AP bring up and the connection
+ * attempt after a save are left out. The pages rendered with several threads are checked against
+ * the single threaded ones. Threads only pay off with as many cores, the ones the host has are
+ * printed first.
+ *
+ * Build and run from the library root:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I. extras/benchmark/ParamsBench.cpp ESPConfig.cpp -o paramsbench
+ *   ./paramsbench [requests]
+ */
+
+#include "ESPConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+const unsigned int PARAMS[]  = {100, 250, 500, 1000};
+const unsigned int THREADS[] = {1, 2, 4, 8};
+
+struct Result {
+    double      pageMillis;
+    double      saveMillis;
+    std::string page;
+};
+
+Result bench(unsigned int params, unsigned int requests) {
+    std::vector<std::string> names(params);
+    std::vector<std::unique_ptr<ESPConfigParam>> owned;
+    ESPConfig config;
+    config.setConfigPortalTimeout(0);
+    for (unsigned int i = 0; i < params; ++i) {
+        char name[12];
+        snprintf(name, sizeof(name), "p%u", i);
+        names[i] = name;
+        owned.push_back(std::unique_ptr<ESPConfigParam>(new ESPConfigParam(Text, names[i].c_str(), names[i].c_str(), "default", 32, "")));
+        config.addParameter(owned.back().get());
+    }
+    std::vector<std::pair<String, String>> form;
+    form.push_back(std::make_pair(String("s"), String("missing")));
+    form.push_back(std::make_pair(String("p"), String("none")));
+    for (unsigned int i = 0; i < params; ++i) {
+        form.push_back(std::make_pair(String(names[i]), String("value-") + String(i)));
+    }
+
+    Result r;
+    HostSim sim;
+    sim.activate();
+    sim.connectDelay = 1;
+    // the portal serves one request per loop, a save ends the session
+    for (unsigned int i = 0; i < requests; ++i) {
+        sim.request(0, "/");
+    }
+    for (unsigned int i = 0; i < requests; ++i) {
+        sim.request(0, "/wifisave", form);
+    }
+    double page = 0;
+    double save = 0;
+    for (unsigned int i = 0; i < requests; ++i) {
+        config.startConfigPortal();
+    }
+    for (size_t i = 0; i < sim.responses.size(); ++i) {
+        const HostResponse& response = sim.responses[i];
+        (response.uri == "/" ? page : save) += response.handlerMillis;
+    }
+    r.pageMillis = page / requests;
+    r.saveMillis = save / requests;
+    r.page = sim.responses.front().content.str();
+    return r;
+}
+
+int main(int argc, char** argv) {
+    unsigned int requests = argc > 1 ? (unsigned int) strtoul(argv[1], NULL, 10) : 50;
+    bool consistent = true;
+    printf("host cores: %u\n", std::thread::hardware_concurrency());
+    printf("%8s %8s %14s %14s\n", "params", "threads", "page (ms/req)", "save (ms/req)");
+    for (size_t p = 0; p < sizeof(PARAMS) / sizeof(PARAMS[0]); ++p) {
+        std::string reference;
+        for (size_t t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); ++t) {
+            HostWorkQueue::shared().setThreads(THREADS[t]);
+            Result r = bench(PARAMS[p], requests);
+            if (t == 0) {
+                reference = r.page;
+            } else if (r.page != reference) {
+                consistent = false;
+            }
+            printf("%8u %8u %14.3f %14.3f\n", PARAMS[p], THREADS[t], r.pageMillis, r.saveMillis);
+        }
+    }
+    printf("parallel pages %s the sequential ones\n", consistent ? "match" : "DO NOT match");
+    return consistent ? 0 : 1;
+}
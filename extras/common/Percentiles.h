@@ -0,0 +1,32 @@
+#ifndef Percentiles_h
+#define Percentiles_h
+
+/*
+ * Percentile helpers shared by the host simulators in extras/. Header only, the simulators are built
+ * as a single file plus ESPConfig.cpp.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+/* Value at fraction p (0 to 1) of v, reorders v */
+inline unsigned long percentile(std::vector<unsigned long>& v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t i = (size_t) (p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+/* Prints p50, p90, p99 and max of v in millis, the title padded to width columns */
+inline void printPercentiles(const char* title, std::vector<unsigned long>& v, int width = 28) {
+    unsigned long p50 = percentile(v, 0.50);
+    unsigned long p90 = percentile(v, 0.90);
+    unsigned long p99 = percentile(v, 0.99);
+    unsigned long max = percentile(v, 1.0);
+    printf("%-*s p50 %7lu  p90 %7lu  p99 %7lu  max %7lu  (ms, n=%zu)\n", width, title, p50, p90, p99, max, v.size());
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Memory footprint report for the static memory mode.
+ *
+ * Prints the bytes used by every component of an ESPConfig built with ESP_CONFIG_STATIC_MEMORY and
+ * then runs a full portal session (captive probe, config page, scan, save and connect) counting
+ * the heap allocations done by the library. Exits with 1 if there is any. The first portal session
+ * registers the web server routes and is not counted, the one counted is the next. The host param
+ * has a name too long for the String small buffer, so a String built from it would be counted.
+ *
+ * Build and run from the library root (the ESP_CONFIG_* sizes can be overridden with -D as well):
+ *
+ *   g++ -std=c++11 -pthread -I. -DESP_CONFIG_STATIC_MEMORY extras/footprint/Footprint.cpp ESPConfig.cpp -o footprint
+ *   ./footprint
+ *
+ * The server sizes, and so the total, are the ones of the host simulation types: on the device they
+ * are the core ESP8266WebServer/WebServer and DNSServer, check them (or the whole object) in the
+ * target build with ESP_CONFIG_RAM_BUDGET.
+ */
+
+#include "ESPConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#ifndef ESP_CONFIG_STATIC_MEMORY
+#error "Build with -DESP_CONFIG_STATIC_MEMORY"
+#endif
+
+static bool             _tracking       = false;
+static unsigned long    _allocations    = 0;
+
+/*
+ * new and delete are not inlined: GCC would see malloc() paired with operator delete, or operator new
+ * with free(), and warn (-Wmismatched-new-delete) though both go through malloc/free here
+ */
+__attribute__((noinline)) void* operator new(size_t size) {
+    if (_tracking && !HostPlatformScope::active()) {
+        _allocations++;
+    }
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// the array forms are replaced as well, so every new is paired with the delete of this file
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+ESPConfigStaticParam<16>    _host (Text, "mqtt_broker_hostname", "MQTT Host", "192.168.0.1", "required");
+ESPConfigStaticParam<6>     _port (Text, "port", "MQTT Port", "1883", "required");
+
+void report(const char* component, size_t bytes) {
+    printf("  %-32s %6zu\n", component, bytes);
+}
+
+int main() {
+    typedef ESPConfigDefaultMemory Memory;
+
+    printf("ESPConfig static footprint (bytes)\n");
+    report("params table", sizeof(Memory::Params));
+    report("render buffer", sizeof(Memory::Page));
+    report("http server (host sim only)", sizeof(Memory::Slot<ESPConfigDefaultTraits::HttpServer>));
+    report("dns server (host sim only)", sizeof(Memory::Slot<ESPConfigDefaultTraits::DnsServer>));
+    report("scan indices (stack)", Memory::MaxScanEntries * sizeof(int));
+    report("session draft", sizeof(Memory::Slot<Memory::Draft>));
+    report("config object total (host sim)", sizeof(ESPConfig));
+    report("param values", sizeof(_host) + sizeof(_port));
+
+    HostSim sim;
+    sim.activate();
+    sim.addNetwork("home", "secret123", -60);
+    sim.addNetwork("neighbour", NULL, -80);
+
+    ESPConfig config;
+    config.addParameter(&_host);
+    config.addParameter(&_port);
+    config.setWifiConnectTimeout(30);
+
+    // an earlier session nobody provisioned
+    config.setConfigPortalTimeout(1);
+    config.startConfigPortal();
+
+    unsigned long t = sim.now;
+    sim.request(t + 1000, "/", {}, "connectivitycheck.gstatic.com");
+    sim.request(t + 1100, "/");
+    sim.request(t + 1200, "/scan");
+    sim.request(t + 1300, "/missing");
+    sim.request(t + 5000, "/wifisave", {{"s", "home"}, {"p", "secret123"}, {"mqtt_broker_hostname", "10.0.0.2"}, {"port", "8883"}});
+    config.setConfigPortalTimeout(60);
+
+    _tracking = true;
+    bool connected = config.connectWifiNetwork(false);
+    _tracking = false;
+
+    printf("portal session: %s, %zu responses, %lu library allocations\n", connected ? "connected" : "not connected", sim.responses.size(), _allocations);
+    return connected && _allocations == 0 ? 0 : 1;
+}
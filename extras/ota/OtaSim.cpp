@@ -0,0 +1,189 @@
+/*
+ * Firmware update (/update) check and throughput report for host builds.
+ *
+ * Uploads images to the portal of a simulated device whose flash is the HostSim fake flash (sector
+ * buffered writes with a simulated erase/write time, see HostUpdater in ESPConfigHost.h) and checks:
+ * a verified image boots after the restart, a wrong MD5, a too large image, an upload without the
+ * credentials and an interrupted upload keep the running firmware, an open portal does not serve
+ * the page, and the portal keeps answering page requests while an upload goes on.
+ * Then reports the upload throughput and the latency of the pages requested meanwhile.
+ *
+ * Build and run from the library root:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I. extras/ota/OtaSim.cpp ESPConfig.cpp -o otasim
+ *   ./otasim [image KB]
+ */
+
+#include "ESPConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+const unsigned long UPLOAD_AT = 1000;
+const char*         PORTAL_PASS = "portal-pass";
+const char*         UPDATE_USER = "admin";
+const char*         UPDATE_PASS = "update-pass";
+
+struct UpdateRun {
+    int             code;           // response to the upload, 0 if none
+    String          content;
+    bool            booted;         // the new image is running
+    unsigned int    restarts;
+    unsigned long   uploadMillis;   // simulated time from request to response
+    unsigned int    progressCalls;
+    bool            progressOrdered;
+    unsigned int    pagesServed;    // pages answered while the upload was going on
+    int             afterCode;      // response to the page requested once the upload is surely over, 0 if none
+    std::vector<unsigned long> pageLatencies;
+};
+
+std::string makeImage(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string image(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        image[i] = (char) (rng() & 0xFF);
+    }
+    return image;
+}
+
+std::string md5(const std::string& data) {
+    HostMD5 hash;
+    hash.add((const uint8_t*) data.data(), data.size());
+    return hash.hex();
+}
+
+/*
+ * Runs a portal session with an upload, sent with the password given, every pageEvery millis
+ * meanwhile a config page request and one more request after the upload
+ */
+UpdateRun runUpdate(const std::string& image, const std::string& expectedMd5, unsigned long chunkMillis, size_t interruptAt, unsigned long pageEvery,
+        const char* pass = UPDATE_PASS) {
+    HostSim sim;
+    sim.activate();
+    sim.authUser = UPDATE_USER;
+    sim.authPass = pass;
+    std::vector<std::pair<String, String>> args;
+    args.push_back(std::make_pair(String("md5"), String(expectedMd5.c_str())));
+    args.push_back(std::make_pair(String("size"), String((unsigned long) image.size())));
+    sim.upload(UPLOAD_AT, "/update", image, args, chunkMillis, interruptAt);
+    // rough upper bound of the upload time, pages are requested along it
+    unsigned long span = (image.size() / HTTP_UPLOAD_BUFLEN + 1) * (chunkMillis + 1) + image.size() / sim.flashSector * sim.flashSectorMillis;
+    if (pageEvery > 0) {
+        for (unsigned long t = UPLOAD_AT + pageEvery; t < UPLOAD_AT + span; t += pageEvery) {
+            sim.request(t, "/");
+        }
+    }
+    const unsigned long afterAt = UPLOAD_AT + span + 500;
+    sim.request(afterAt, "/");
+
+    UpdateRun r = UpdateRun();
+    r.progressOrdered = true;
+    size_t last = 0;
+    ESPConfig config;
+    config.setPortalPassword(PORTAL_PASS);
+    config.setFirmwareUpdate(UPDATE_USER, UPDATE_PASS);
+    config.setConfigPortalTimeout(30);
+    config.setUpdateProgressCallback([&r, &last](size_t progress, size_t) {
+        r.progressCalls++;
+        r.progressOrdered = r.progressOrdered && progress >= last;
+        last = progress;
+    });
+    config.startConfigPortal();
+
+    unsigned long uploadEnd = 0;
+    for (size_t i = 0; i < sim.responses.size(); ++i) {
+        const HostResponse& response = sim.responses[i];
+        if (response.requestAt == UPLOAD_AT) {
+            r.code = response.code;
+            r.content = response.content;
+            r.uploadMillis = response.at - response.requestAt;
+            uploadEnd = response.at;
+        }
+    }
+    for (size_t i = 0; i < sim.responses.size(); ++i) {
+        const HostResponse& response = sim.responses[i];
+        if (response.requestAt == afterAt) {
+            r.afterCode = response.code;
+        } else if (response.requestAt != UPLOAD_AT && (uploadEnd == 0 || response.at <= uploadEnd)) {
+            r.pagesServed++;
+            r.pageLatencies.push_back(response.at - response.requestAt);
+        }
+    }
+    r.booted = sim.firmware == image;
+    r.restarts = sim.restarts;
+    return r;
+}
+
+/* Response code to the update page of a portal without password */
+int openPortalUpdatePage() {
+    HostSim sim;
+    sim.activate();
+    sim.authUser = UPDATE_USER;
+    sim.authPass = UPDATE_PASS;
+    sim.request(UPLOAD_AT, "/update");
+    ESPConfig config;
+    config.setFirmwareUpdate(UPDATE_USER, UPDATE_PASS);
+    config.setConfigPortalTimeout(5);
+    config.startConfigPortal();
+    return sim.responses.empty() ? 0 : sim.responses[0].code;
+}
+
+bool check(const char* name, bool ok) {
+    printf("  %-52s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    size_t imageSize = (argc > 1 ? strtoul(argv[1], NULL, 10) : 400) * 1024;
+    std::string image = makeImage(imageSize, 1);
+    std::string imageMd5 = md5(image);
+    bool ok = true;
+
+    printf("update scenarios (%zu KB image)\n", imageSize / 1024);
+    UpdateRun good = runUpdate(image, imageMd5, 2, std::string::npos, 0);
+    ok &= check("verified image boots after restart", good.code == 200 && good.booted && good.restarts == 1);
+    ok &= check("progress reported in order for every chunk", good.progressOrdered && good.progressCalls == (imageSize + HTTP_UPLOAD_BUFLEN - 1) / HTTP_UPLOAD_BUFLEN);
+
+    UpdateRun badMd5 = runUpdate(image, md5("other image"), 2, std::string::npos, 0);
+    ok &= check("wrong MD5 keeps running firmware", badMd5.code == 500 && !badMd5.booted && badMd5.restarts == 0);
+
+    UpdateRun invalidMd5 = runUpdate(image, "not a digest", 2, std::string::npos, 0);
+    std::string md5Error = "(error " + std::to_string(UPDATE_ERROR_MD5) + ")";
+    ok &= check("invalid MD5 reports it and no progress", invalidMd5.code == 500 && !invalidMd5.booted && invalidMd5.progressCalls == 0
+        && invalidMd5.content.str().find(md5Error) != std::string::npos);
+
+    UpdateRun noMd5 = runUpdate(image, "", 2, std::string::npos, 0);
+    ok &= check("image without MD5 boots", noMd5.code == 200 && noMd5.booted);
+
+    UpdateRun noAuth = runUpdate(image, imageMd5, 2, std::string::npos, 0, "guess");
+    ok &= check("upload without the credentials is refused", noAuth.code == 401 && !noAuth.booted && noAuth.restarts == 0);
+    ok &= check("no update page on a portal without password", openPortalUpdatePage() == 404);
+
+    UpdateRun tooLarge = runUpdate(makeImage(2 << 20, 2), "", 2, std::string::npos, 0);
+    ok &= check("image larger than the flash keeps running firmware", tooLarge.code == 500 && !tooLarge.booted && tooLarge.restarts == 0);
+
+    UpdateRun interrupted = runUpdate(image, imageMd5, 2, imageSize * 2 / 5, 500);
+    ok &= check("interrupted upload keeps running firmware", interrupted.code == 0 && !interrupted.booted && interrupted.restarts == 0);
+    ok &= check("portal serves pages after the interrupted upload", interrupted.afterCode == 200);
+
+    printf("throughput (pages requested every 200 ms during the upload)\n");
+    printf("%12s %12s %12s %12s %14s %14s\n", "chunk (ms)", "upload (ms)", "KB/s (sim)", "pages", "page p50 (ms)", "page max (ms)");
+    const unsigned long CHUNK_MILLIS[] = {0, 2, 10};
+    for (size_t i = 0; i < sizeof(CHUNK_MILLIS) / sizeof(CHUNK_MILLIS[0]); ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        UpdateRun r = runUpdate(image, imageMd5, CHUNK_MILLIS[i], std::string::npos, 200);
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ok &= r.booted;
+        std::vector<unsigned long>& l = r.pageLatencies;
+        std::sort(l.begin(), l.end());
+        printf("%12lu %12lu %12.1f %12u %14lu %14lu   (host %.1f MB/s)\n", CHUNK_MILLIS[i], r.uploadMillis, imageSize / 1024.0 / (r.uploadMillis / 1000.0),
+            r.pagesServed, l.empty() ? 0 : l[l.size() / 2], l.empty() ? 0 : l.back(), imageSize / wall / (1 << 20));
+    }
+    printf("%s\n", ok ? "all checks passed" : "SOME CHECKS FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,269 @@
+/*
+ * Portal session resume simulator for host builds.
+ *
+ * Runs provisioning sessions where the device resets (watchdog, brownout) at a random point while a
+ * phone fills the portal form field by field: on the config page, in the middle of a scan, between
+ * two fields or while connecting to the network sent. After the reset the phone keeps reloading the
+ * portal until it answers and then completes whatever the form lost. Every session runs with and
+ * without setSessionResume and the report compares the time from the reset to the portal being up
+ * again and to the phone getting the form, how many of the fields already typed came back filled
+ * and the time from the reset to provisioned. Last it checks a portal nobody used (the saved network
+ * was down for a while) is not resumed: after a reset the saved network, back up, is joined.
+ *
+ * Build and run from the library root:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I. extras/resume/ResumeSim.cpp ESPConfig.cpp -o resumesim
+ *   ./resumesim [sessions] [seed]
+ */
+
+#include "ESPConfig.h"
+#include "../common/Percentiles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+const char*         TARGET_SSID             = "home-net";
+const char*         TARGET_PASS             = "home-pass";
+const unsigned long BOOT_MILLIS             = 250;      // from the reset to setup()
+const unsigned long RELOAD_MILLIS           = 250;      // the phone reloads the portal this often
+const unsigned long PORTAL_TIMEOUT_SECS     = 300;
+const unsigned long CONNECT_TIMEOUT_SECS    = 10;
+
+struct Field {
+    const char*     name;
+    std::string     value;
+};
+
+struct SessionResult {
+    bool            provisioned;
+    unsigned long   portalUp;       // simulated millis from the reset to the portal web server started
+    unsigned long   recovery;       // simulated millis from the reset to the form served again
+    unsigned long   provision;      // simulated millis from the reset to connected
+    unsigned int    typed;          // fields sent before the reset
+    unsigned int    restored;       // of those, the ones that came back filled
+};
+
+/* What the phone does, shared by the sim events */
+struct Phone {
+    std::mt19937            rng;
+    std::vector<Field>      fields;
+    unsigned long           resetAt         = 0;
+    unsigned long           portalUpAt      = 0;
+    unsigned long           recoveredAt     = 0;
+    size_t                  firstResponse   = 0;    // responses before this one were sent before the reset
+    unsigned int            typed           = 0;
+    unsigned int            restored        = 0;
+
+    Phone(uint32_t seed) : rng(seed) {}
+
+    unsigned long think() {
+        return 1000 + rng() % 3000;
+    }
+
+    bool filled(const String& page, const Field& f) {
+        std::string attr = std::string("name='") + f.name + "'";
+        size_t input = page.str().find(attr);
+        return input != std::string::npos && page.str().find("value='" + f.value + "'", input) != std::string::npos;
+    }
+
+    /* Types the fields missing (autosaving them) and sends the whole form */
+    void fill(HostSim& sim, unsigned long t, const std::vector<Field>& missing) {
+        for (size_t i = 0; i < missing.size(); ++i) {
+            t += think();
+            sim.request(t, "/draft", {{missing[i].name, missing[i].value.c_str()}});
+        }
+        t += think();   // the password, never autosaved
+        std::vector<std::pair<String, String>> form;
+        form.push_back(std::make_pair(String("p"), String(TARGET_PASS)));
+        for (size_t i = 0; i < fields.size(); ++i) {
+            form.push_back(std::make_pair(String(fields[i].name), String(fields[i].value.c_str())));
+        }
+        sim.request(t, "/wifisave", form);
+    }
+
+    /* Reloads the portal until it answers, then completes the form */
+    void reload(HostSim& sim) {
+        for (size_t i = firstResponse; i < sim.responses.size(); ++i) {
+            const HostResponse& r = sim.responses[i];
+            if (r.uri == "/" && r.code == 200) {
+                portalUpAt = sim.serverUpAt;
+                recoveredAt = r.at;
+                // the fields came back filled are not typed again
+                std::vector<Field> missing;
+                for (size_t f = 0; f < fields.size(); ++f) {
+                    if (filled(r.content, fields[f])) {
+                        restored += f < typed ? 1 : 0;
+                    } else {
+                        missing.push_back(fields[f]);
+                    }
+                }
+                fill(sim, sim.now, missing);
+                return;
+            }
+        }
+        if (sim.apUp && sim.stations == 0) {
+            sim.stations++;
+        }
+        sim.request(sim.now, "/");
+        sim.at(sim.now + RELOAD_MILLIS, [this](HostSim& s) { reload(s); });
+    }
+};
+
+/* Boots the device until connectWifiNetwork returns, rebooting it when it resets */
+bool runDevice(HostSim& sim, Phone& phone, bool resume, bool existsConfig) {
+    while (true) {
+        ESPConfigParam host(Text, "host", "Host", "", 24, "");
+        ESPConfigParam port(Text, "port", "Port", "1883", 6, "");
+        ESPConfig config;
+        config.addParameter(&host);
+        config.addParameter(&port);
+        config.setSessionResume(resume);
+        config.setWifiConnectTimeout(CONNECT_TIMEOUT_SECS);
+        config.setConfigPortalTimeout(PORTAL_TIMEOUT_SECS);
+        try {
+            return config.connectWifiNetwork(existsConfig);
+        } catch (const HostReset&) {
+            phone.resetAt = sim.now;
+            sim.reboot();
+            sim.advance(BOOT_MILLIS);
+            phone.firstResponse = sim.responses.size();
+            sim.at(sim.now + RELOAD_MILLIS, [&phone](HostSim& s) { phone.reload(s); });
+        }
+    }
+}
+
+SessionResult runSession(uint32_t seed, bool resume) {
+    std::mt19937 rng(seed);
+    HostSim sim;
+    sim.activate();
+    sim.chipId = seed;
+    sim.connectDelay = 500 + rng() % 2000;
+    sim.apStartDelay = 50 + rng() % 200;
+    sim.addNetwork(TARGET_SSID, TARGET_PASS, -50 - (int32_t) (rng() % 30));
+    sim.addNetwork("neighbour", "x", -70);
+    // half of the devices are being moved to a new network, the saved one is gone
+    bool existsConfig = rng() % 2 == 0;
+    if (existsConfig) {
+        sim.savedSsid = "old-net";
+        sim.savedPass = "old-pass";
+    }
+
+    Phone phone(seed);
+    phone.fields.push_back(Field{"s", TARGET_SSID});
+    phone.fields.push_back(Field{"host", "10.0.0." + std::to_string(rng() % 250)});
+    phone.fields.push_back(Field{"port", std::to_string(1000 + rng() % 9000)});
+    unsigned long first = (existsConfig ? CONNECT_TIMEOUT_SECS * 1000 : 0) + 1000 + rng() % 2000;
+    sim.at(first - 100, [](HostSim& s) { s.stations++; });
+    sim.request(first, "/");
+    unsigned long t = first;
+    if (rng() % 3 == 0) {
+        t += 500;
+        sim.request(t, "/scan");
+        t += sim.scanDuration;
+    }
+    // field i is sent at fieldAt[i], the form at the end
+    std::vector<unsigned long> fieldAt;
+    for (size_t i = 0; i < phone.fields.size(); ++i) {
+        t += phone.think();
+        fieldAt.push_back(t);
+    }
+    unsigned long saveAt = t + phone.think();
+    for (size_t i = 0; i < phone.fields.size(); ++i) {
+        sim.request(fieldAt[i], "/draft", {{phone.fields[i].name, phone.fields[i].value.c_str()}});
+    }
+    std::vector<std::pair<String, String>> form;
+    form.push_back(std::make_pair(String("p"), String(TARGET_PASS)));
+    for (size_t i = 0; i < phone.fields.size(); ++i) {
+        form.push_back(std::make_pair(String(phone.fields[i].name), String(phone.fields[i].value.c_str())));
+    }
+    sim.request(saveAt, "/wifisave", form);
+
+    // anywhere from the first page to the end of the connection attempt
+    unsigned long resetAt = first + 1 + rng() % (saveAt + sim.connectDelay + 1000 - first);
+    for (size_t i = 0; i < fieldAt.size(); ++i) {
+        phone.typed += fieldAt[i] < resetAt ? 1 : 0;
+    }
+    sim.resetAt(resetAt);
+
+    SessionResult r;
+    r.provisioned = runDevice(sim, phone, resume, existsConfig);
+    r.typed = saveAt < resetAt ? 0 : phone.typed;  // after the save the form is gone anyway
+    r.restored = saveAt < resetAt ? 0 : phone.restored;
+    r.portalUp = phone.portalUpAt > phone.resetAt ? phone.portalUpAt - phone.resetAt : 0;
+    r.recovery = phone.recoveredAt > phone.resetAt ? phone.recoveredAt - phone.resetAt : 0;
+    r.provision = sim.now - phone.resetAt;
+    return r;
+}
+
+/* Millis from the reboot to connected to the saved network, 0 if it was not */
+unsigned long unattendedReset() {
+    HostSim sim;
+    sim.activate();
+    sim.savedSsid = TARGET_SSID;
+    sim.savedPass = TARGET_PASS;
+    // the router is down, the portal opens with nobody around and the device resets
+    sim.resetAt(CONNECT_TIMEOUT_SECS * 1000 + 10000);
+    try {
+        ESPConfig config;
+        config.setSessionResume(true);
+        config.setWifiConnectTimeout(CONNECT_TIMEOUT_SECS);
+        config.connectWifiNetwork(true);
+    } catch (const HostReset&) {
+        sim.reboot();
+    }
+    sim.addNetwork(TARGET_SSID, TARGET_PASS, -50);
+    unsigned long start = sim.now;
+    // the portal has no timeout, give up on it after a while
+    sim.resetAt(start + PORTAL_TIMEOUT_SECS * 1000);
+    try {
+        ESPConfig config;
+        config.setSessionResume(true);
+        config.setWifiConnectTimeout(CONNECT_TIMEOUT_SECS);
+        return config.connectWifiNetwork(true) ? sim.now - start : 0;
+    } catch (const HostReset&) {
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long sessions = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+    uint32_t seed = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 1;
+    for (int resume = 0; resume < 2; ++resume) {
+        std::vector<unsigned long> portalUp;
+        std::vector<unsigned long> recovery;
+        std::vector<unsigned long> provision;
+        unsigned long typed = 0;
+        unsigned long restored = 0;
+        unsigned long provisioned = 0;
+        for (unsigned long i = 0; i < sessions; ++i) {
+            SessionResult r = runSession(seed + (uint32_t) i, resume != 0);
+            if (r.recovery > 0) {
+                portalUp.push_back(r.portalUp);
+                recovery.push_back(r.recovery);
+            }
+            if (r.provisioned) {
+                provisioned++;
+                provision.push_back(r.provision);
+            }
+            typed += r.typed;
+            restored += r.restored;
+        }
+        printf("%s (%lu sessions, one reset each)\n", resume ? "session resume" : "no session resume", sessions);
+        printPercentiles("  reset to portal up", portalUp, 32);
+        printPercentiles("  reset to form served again", recovery, 32);
+        printPercentiles("  reset to provisioned", provision, 32);
+        printf("  %-30s %lu of %lu (%.1f%%)\n", "typed fields restored", restored, typed, typed > 0 ? 100.0 * restored / typed : 0.0);
+        printf("  %-30s %lu (%.1f%%)\n", "provisioned", provisioned, 100.0 * provisioned / sessions);
+    }
+    unsigned long unattended = unattendedReset();
+    if (unattended > 0) {
+        printf("unattended portal reset: saved network joined after %lu ms\n", unattended);
+    } else {
+        printf("unattended portal reset: saved network NOT joined\n");
+    }
+    return unattended > 0 ? 0 : 1;
+}
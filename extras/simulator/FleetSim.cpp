@@ -0,0 +1,195 @@
+/*
+ * Fleet provisioning simulator.
+ *
+ * Runs many ESPConfig provisioning sessions on the host, spread over worker threads. Every session
+ * is a simulated device (its own clock, radio and web clients, see ESPConfigHost.h) going through the
+ * real connectWifiNetwork/startConfigPortal/handleWifiSave/waitForConnectResult code while phones
+ * hit the portal following a random script: slow clients, wrong passwords, probe storms and flapping
+ * access points.
+ *
+ * Build and run from the library root:
+ *
+ *   g++ -std=c++11 -O2 -pthread -I. extras/simulator/FleetSim.cpp ESPConfig.cpp -o fleetsim
+ *   ./fleetsim [sessions] [threads] [seed]
+ */
+
+#include "ESPConfig.h"
+#include "../common/Percentiles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+const char*         TARGET_SSID         = "fleet-net";
+const char*         TARGET_PASS         = "fleet-pass";
+const unsigned long PORTAL_TIMEOUT_SECS = 60;
+const unsigned long CONNECT_TIMEOUT_SECS = 15;
+
+enum Outcome {Provisioned, PortalTimeout, OUTCOMES};
+enum Failure {WrongPassword, SsidNotAvailable, ConnectTimeout, FAILURES};
+
+const char* OUTCOME_NAMES[OUTCOMES] = {"provisioned", "portal timed out"};
+const char* FAILURE_NAMES[FAILURES] = {"wrong password", "ssid not available", "connect timed out"};
+
+struct SessionResult {
+    Outcome         outcome;
+    unsigned long   elapsed;            // simulated millis until connectWifiNetwork returned
+    unsigned int    failures[FAILURES]; // failed station connection attempts by cause
+    std::vector<unsigned long> latencies;
+};
+
+struct Stats {
+    std::vector<unsigned long>  provisionTimes;
+    std::vector<unsigned long>  latencies;
+    unsigned long               outcomes[OUTCOMES] = {0};
+    unsigned long               failures[FAILURES] = {0};
+    unsigned long               requests = 0;
+
+    void add(const SessionResult& r) {
+        outcomes[r.outcome]++;
+        for (int i = 0; i < FAILURES; ++i) {
+            failures[i] += r.failures[i];
+        }
+        requests += r.latencies.size();
+        if (r.outcome == Provisioned) {
+            provisionTimes.push_back(r.elapsed);
+        }
+        latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+    }
+
+    void merge(const Stats& o) {
+        provisionTimes.insert(provisionTimes.end(), o.provisionTimes.begin(), o.provisionTimes.end());
+        latencies.insert(latencies.end(), o.latencies.begin(), o.latencies.end());
+        for (int i = 0; i < OUTCOMES; ++i) {
+            outcomes[i] += o.outcomes[i];
+        }
+        for (int i = 0; i < FAILURES; ++i) {
+            failures[i] += o.failures[i];
+        }
+        requests += o.requests;
+    }
+};
+
+/* Queues the requests of one phone: captive probes, the config page, maybe a scan, and a save */
+void scriptPhone(HostSim& sim, std::mt19937& rng, unsigned long start, bool slow, bool wrongPassword, bool probeStorm) {
+    std::uniform_int_distribution<unsigned long> think(slow ? 3000 : 200, slow ? 15000 : 2000);
+    unsigned long t = start;
+    sim.at(t > 100 ? t - 100 : 0, [](HostSim& s) { s.stations++; });
+    unsigned int probes = probeStorm ? 50 : 2;
+    for (unsigned int i = 0; i < probes; ++i) {
+        sim.request(t, "/generate_204", {}, "connectivitycheck.gstatic.com");
+        t += probeStorm ? 20 : 300;
+    }
+    sim.request(t, "/");
+    t += think(rng);
+    if (rng() % 3 == 0) {
+        sim.request(t, "/scan");
+        t += think(rng);
+    }
+    sim.request(t, "/wifisave", {{"s", TARGET_SSID}, {"p", wrongPassword ? "guess" : TARGET_PASS}, {"host", "10.0.0.1"}});
+    t += think(rng);
+    sim.at(t, [](HostSim& s) { if (s.stations > 0) s.stations--; });
+}
+
+SessionResult runSession(uint32_t seed) {
+    std::mt19937 rng(seed);
+    HostSim sim;
+    sim.activate();
+    sim.chipId = seed;
+    sim.connectDelay = 500 + rng() % 3000;
+    sim.addNetwork(TARGET_SSID, TARGET_PASS, -40 - (int32_t) (rng() % 50));
+    for (int i = rng() % 12; i > 0; --i) {
+        char ssid[16];
+        snprintf(ssid, sizeof(ssid), "neighbour-%d", i);
+        sim.addNetwork(ssid, rng() % 4 ? "x" : NULL, -50 - (int32_t) (rng() % 50));
+    }
+    // the target AP disappears for a while
+    if (rng() % 10 == 0) {
+        unsigned long down = 1000 + rng() % 20000;
+        unsigned long up = down + 2000 + rng() % 20000;
+        HostNetwork target = sim.networks[0];
+        sim.at(down, [](HostSim& s) { s.removeNetwork(TARGET_SSID); });
+        sim.at(up, [target](HostSim& s) { s.networks.push_back(target); });
+    }
+    unsigned int phones = 1 + rng() % 4;
+    for (unsigned int i = 0; i < phones; ++i) {
+        bool last = i == phones - 1;
+        scriptPhone(sim, rng, 600 + rng() % 10000, rng() % 5 == 0, !last || rng() % 4 == 0, rng() % 8 == 0);
+    }
+
+    ESPConfigParam host(Text, "host", "Host", "", 16, "");
+    ESPConfig config;
+    config.addParameter(&host);
+    config.setWifiConnectTimeout(CONNECT_TIMEOUT_SECS);
+    config.setConfigPortalTimeout(PORTAL_TIMEOUT_SECS);
+    bool connected = config.connectWifiNetwork(true);
+
+    SessionResult r;
+    r.elapsed = sim.now;
+    r.outcome = connected ? Provisioned : PortalTimeout;
+    for (size_t i = 0; i < sim.responses.size(); ++i) {
+        r.latencies.push_back(sim.responses[i].at - sim.responses[i].requestAt);
+    }
+    for (int i = 0; i < FAILURES; ++i) {
+        r.failures[i] = 0;
+    }
+    for (size_t i = 0; i < sim.connectResults.size(); ++i) {
+        if (sim.connectResults[i] == WL_CONNECT_FAILED) {
+            r.failures[WrongPassword]++;
+        } else if (sim.connectResults[i] == WL_NO_SSID_AVAIL) {
+            r.failures[SsidNotAvailable]++;
+        }
+    }
+    // attempts abandoned before the radio came up with a result
+    unsigned int resolved = sim.connectResults.size();
+    r.failures[ConnectTimeout] = sim.connectAttempts > resolved ? sim.connectAttempts - resolved : 0;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    unsigned long sessions = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    unsigned int threads = argc > 2 ? (unsigned int) strtoul(argv[2], NULL, 10) : std::thread::hardware_concurrency();
+    uint32_t seed = argc > 3 ? (uint32_t) strtoul(argv[3], NULL, 10) : 1;
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    std::atomic<unsigned long> next(0);
+    std::vector<Stats> partials(threads);
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t]() {
+            unsigned long i;
+            while ((i = next++) < sessions) {
+                partials[t].add(runSession(seed + (uint32_t) i));
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Stats total;
+    for (size_t t = 0; t < partials.size(); ++t) {
+        total.merge(partials[t]);
+    }
+    printf("%lu sessions on %u threads in %.2fs (%.0f sessions/s)\n", sessions, threads, wall, sessions / wall);
+    printf("%lu portal requests served\n", total.requests);
+    printPercentiles("time to provisioned", total.provisionTimes);
+    printPercentiles("portal request latency", total.latencies);
+    for (int i = 0; i < OUTCOMES; ++i) {
+        printf("%-28s %7lu  (%.1f%%)\n", OUTCOME_NAMES[i], total.outcomes[i], 100.0 * total.outcomes[i] / sessions);
+    }
+    printf("failed connection attempts:\n");
+    for (int i = 0; i < FAILURES; ++i) {
+        printf("  %-26s %7lu\n", FAILURE_NAMES[i], total.failures[i]);
+    }
+    return 0;
+}